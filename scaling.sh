@@ -0,0 +1,36 @@
+#! /bin/bash
+# scaling benchmark of path_planning --threads. starts the server on 1 to N
+# threads and floods it with load_client on localhost, printing the replies a
+# second and the sessions per core it sustains at every thread count.
+#
+# run from the build directory: ../scaling.sh [max_threads] [sessions] [duration]
+# max_threads defaults to half the cores, the other half runs load_client.
+
+cores=$(nproc)
+max_threads=${1:-$(( cores > 1 ? cores / 2 : 1 ))}
+sessions=${2:-200}
+duration=${3:-10}
+client_threads=$(( cores - max_threads > 1 ? cores - max_threads : 1 ))
+
+if [ ! -x ./path_planning ] || [ ! -x ./load_client ]; then
+  echo "run from the build directory, path_planning and load_client are needed" >&2
+  exit 1
+fi
+
+echo "threads  replies/s  speedup  sessions/core at 25 Hz"
+base=""
+for (( n = 1; n <= max_threads; n++ )); do
+  ./path_planning --threads $n > /dev/null &
+  server=$!
+  sleep 1
+
+  out=$(./load_client --flood --sessions $sessions --threads $client_threads --server-cores $n --duration $duration)
+
+  kill $server
+  wait $server 2> /dev/null
+
+  rate=$(echo "$out" | sed -n 's/.*replies [0-9]* (\([0-9.]*\)\/s).*/\1/p')
+  per_core=$(echo "$out" | sed -n 's/^sustainable sessions per server core.*: //p')
+  base=${base:-$rate}
+  printf "%7d  %9.0f  %6.2fx  %s\n" $n $rate $(echo "$rate / $base" | bc -l) "$per_core"
+done
@@ -0,0 +1,295 @@
+// offline batch planner: runs the planning code of path_planning over
+// recorded telemetry without uWS or any network, for regression runs and
+// profiling on large corpora.
+//
+// usage: batch_planner [--threads N] [--out <dir>|-] <input>...
+//
+// an input is a frame log written by path_planning --record, every recorded
+// connection of it is one session, or a text file with one raw
+// 42["telemetry",{...}] frame per line, which is one session. a file is a
+// frame log if it starts with the frame log magic, one that does but is
+// damaged or of another version stops the run. "-" reads text frames from
+// stdin. every session gets its own Planner, the sessions are spread over N
+// threads (all cores by default) and share the one map. a tiled map is only
+// queried from one thread, every thread opens its own.
+//
+// with --out every session writes its replies, the 42["control",{"next_x":
+// [...],"next_y":[...]}] frames, one per line to <dir>/<input>.<connection>.out
+// or <dir>/<input>.out. replies to binary frames are written as the same text.
+// "--out -" writes them to stdout and runs one thread. the summary ends with
+// a checksum over all replies in session order, which only changes when a
+// planned path does.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "control_message.h"
+#include "frame_log.h"
+#include "planner.h"
+#include "tool_common.h"
+
+using namespace std;
+
+// one independent planner run
+struct Session
+{
+  // output file name, without directory
+  string name;
+
+  // frames of one connection of a frame log, pointing into the mapping
+  vector<const char *> data;
+  vector<uint32_t> length;
+  vector<bool> binary;
+
+  // text frames are read line by line from here instead, "-" is stdin
+  string text_path;
+
+  // results
+  uint64_t frames;
+  uint64_t replies;
+  uint64_t checksum;
+  bool failed;
+};
+
+static string BaseName(const string &path)
+{
+  size_t slash = path.find_last_of('/');
+  return (slash == string::npos) ? path : path.substr(slash + 1);
+}
+
+// whether the file starts like a frame log. anything else is read as text
+// frames, a frame log that fails to open is an error.
+static bool HasFrameLogMagic(const string &path)
+{
+  char magic[sizeof(kFrameLogMagic)];
+  ifstream file(path.c_str(), ifstream::binary);
+  file.read(magic, sizeof(magic));
+  return file && memcmp(magic, kFrameLogMagic, sizeof(magic)) == 0;
+}
+
+// the sessions of one frame log, in connection order
+static void AddLogSessions(const string &path, FrameLog &log, vector<Session> &sessions)
+{
+  map<uint32_t, size_t> by_connection;
+
+  FrameLogRecord record;
+  const char *data;
+  log.Rewind();
+  while (log.Next(record, data)) {
+    auto found = by_connection.find(record.connection);
+    if (found == by_connection.end()) {
+      found = by_connection.insert(make_pair(record.connection, sessions.size())).first;
+      sessions.push_back(Session());
+      sessions.back().name = BaseName(path) + "." + to_string(record.connection) + ".out";
+    }
+    Session &session = sessions[found->second];
+    session.data.push_back(data);
+    session.length.push_back(record.length);
+    session.binary.push_back(record.opcode == kFrameBinary);
+  }
+}
+
+static void RunSession(PlannerMap &planner_map, Session &session, ostream &log, ostream *out)
+{
+  Planner planner(planner_map);
+  planner.set_log(&log);
+
+  session.frames = session.replies = 0;
+  session.checksum = kFnv1aBasis;
+  session.failed = false;
+
+  // binary replies are written out as the text control frame of the same path
+  ControlMessage text;
+  vector<double> next_x;
+  vector<double> next_y;
+
+  auto plan = [&](const char *data, size_t length, bool binary) {
+    const char *reply;
+    size_t reply_length;
+    session.frames++;
+    if (planner.OnMessage(data, length, binary, reply, reply_length)) {
+      session.checksum = Fnv1a(session.checksum, reply, reply_length);
+      session.replies++;
+      bool delta;
+      uint32_t base, ack_seq;
+      if (out != NULL && binary && DecodeBinaryControl(reply, reply_length, next_x, next_y, delta, base, ack_seq)) {
+        if (delta) {
+          text.WriteDelta(ack_seq, base, next_x.data(), next_y.data(), next_x.size());
+        } else {
+          text.Write(next_x.data(), next_y.data(), next_x.size());
+        }
+        reply = text.data();
+        reply_length = text.length();
+      }
+      if (out != NULL) {
+        out->write(reply, reply_length);
+        out->put('\n');
+      }
+    }
+  };
+
+  if (session.text_path.empty()) {
+    for (size_t i = 0; i < session.data.size(); i++) {
+      plan(session.data[i], session.length[i], session.binary[i]);
+    }
+    return;
+  }
+
+  ifstream file;
+  istream *in = &std::cin;
+  if (session.text_path != "-") {
+    file.open(session.text_path.c_str());
+    if (!file) {
+      std::cerr << "can't open " << session.text_path << std::endl;
+      session.failed = true;
+      return;
+    }
+    in = &file;
+  }
+
+  string line;
+  while (getline(*in, line)) {
+    if (!line.empty()) {
+      plan(line.data(), line.size(), false);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  int threads = thread::hardware_concurrency();
+  string out_dir;
+
+  int arg = 1;
+  for (; arg + 1 < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg += 2) {
+    if (strcmp(argv[arg], "--threads") == 0) {
+      threads = atoi(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "--out") == 0) {
+      out_dir = argv[arg + 1];
+    } else {
+      break;
+    }
+  }
+
+  if (arg >= argc || strncmp(argv[arg], "--", 2) == 0) {
+    std::cerr << "usage: batch_planner [--threads N] [--out <dir>|-] <input>..." << std::endl;
+    return 1;
+  }
+
+  bool to_stdout = (out_dir == "-");
+  if (to_stdout || threads < 1) {
+    threads = 1;
+  }
+
+  // frame logs stay mapped until the end, the sessions point into them
+  vector<unique_ptr<FrameLog> > logs;
+  vector<Session> sessions;
+
+  for (; arg < argc; arg++) {
+    string path = argv[arg];
+
+    if (path != "-" && HasFrameLogMagic(path)) {
+      unique_ptr<FrameLog> log(new FrameLog());
+      if (!log->Open(path)) {
+        std::cerr << log->error() << std::endl;
+        return 1;
+      }
+      AddLogSessions(path, *log, sessions);
+      logs.push_back(move(log));
+      continue;
+    }
+
+    sessions.push_back(Session());
+    sessions.back().name = (path == "-" ? string("stdin") : BaseName(path)) + ".out";
+    sessions.back().text_path = path;
+  }
+
+  // the summary goes to stderr when the replies go to stdout
+  ostream &summary = to_stdout ? std::cerr : std::cout;
+
+  // the same map the server loads
+  PlannerMap planner_map;
+  if (!planner_map.Load(kMapTilesFile, kMapBinFile, kMapCsvFile, kMapMaxS,
+                        summary)) {
+    return 1;
+  }
+
+  // planner decisions would interleave from all threads, they are dropped
+  ostream null_log(NULL);
+
+  // a tiled map caches tiles and is queried from one thread only, every
+  // further thread opens the tile file again for a cache of its own
+  vector<unique_ptr<PlannerMap> > thread_maps;
+  for (int t = 1; t < threads && planner_map.use_tiles; t++) {
+    thread_maps.push_back(unique_ptr<PlannerMap>(new PlannerMap()));
+    if (!thread_maps.back()->Load(kMapTilesFile, kMapBinFile, kMapCsvFile, kMapMaxS, null_log)) {
+      return 1;
+    }
+  }
+
+  auto start = chrono::steady_clock::now();
+
+  // sessions are handed out one at a time, a session is planned start to end by one thread
+  atomic<size_t> next_session(0);
+  auto worker = [&](PlannerMap &thread_map) {
+    size_t i;
+    while ((i = next_session++) < sessions.size()) {
+      Session &session = sessions[i];
+      if (to_stdout) {
+        RunSession(thread_map, session, null_log, &std::cout);
+      } else if (!out_dir.empty()) {
+        ofstream out((out_dir + "/" + session.name).c_str());
+        RunSession(thread_map, session, null_log, &out);
+        session.failed = session.failed || !out;
+      } else {
+        RunSession(thread_map, session, null_log, NULL);
+      }
+    }
+  };
+
+  vector<thread> pool;
+  for (int t = 1; t < threads; t++) {
+    PlannerMap &thread_map = planner_map.use_tiles ? *thread_maps[t - 1] : planner_map;
+    pool.push_back(thread([&worker,&thread_map]() { worker(thread_map); }));
+  }
+  worker(planner_map);
+  for (auto &t : pool) {
+    t.join();
+  }
+
+  double wall_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  uint64_t frames = 0;
+  uint64_t replies = 0;
+  uint64_t checksum = kFnv1aBasis;
+  bool failed = false;
+  for (const Session &session : sessions) {
+    frames += session.frames;
+    replies += session.replies;
+    checksum = Fnv1a(checksum, (const char *)&session.checksum, sizeof(session.checksum));
+    if (session.failed) {
+      std::cerr << "session " << session.name << " failed" << std::endl;
+      failed = true;
+    }
+  }
+
+  summary << sessions.size() << " sessions, " << frames << " frames, " << replies << " replies on ";
+  summary << threads << " threads in " << wall_s << " s" << std::endl;
+  summary << (wall_s > 0 ? frames / wall_s * 60 : 0) << " frames/min" << std::endl;
+  char hex[32];
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)checksum);
+  summary << "checksum " << hex << std::endl;
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+#ifndef BINARY_FRAME_H
+#define BINARY_FRAME_H
+
+#include <stdint.h>
+
+// fixed-layout binary frames for our own clients, sent as websocket BINARY
+// messages instead of the socket.io text the simulator speaks. a connection
+// that sends binary telemetry gets binary control frames back, text stays
+// text. numbers are the same doubles the text carries, so a path read back
+// from a binary frame is bit for bit the path that was sent.
+//
+// a telemetry frame with kBinaryFlagDelta asks for a delta control frame:
+// the first base points of the next path are the previous path the client
+// sent, only the n points appended to it are in the frame. ack_seq echoes the
+// seq of the telemetry frame. a full control frame has base 0.
+//
+// layout: a BinaryFrameHeader, the fixed part of the frame type, then its
+// arrays. little-endian, no padding. frames arrive at any alignment and are
+// read with memcpy.
+//
+//   telemetry:  BinaryTelemetryFrame
+//               double previous_path_x[prev_size]
+//               double previous_path_y[prev_size]
+//               double sensor_fusion[num_cars][7]   [id, x, y, vx, vy, s, d]
+//
+//   control:    BinaryControlFrame
+//               double next_x[n]
+//               double next_y[n]
+
+static const uint32_t kBinaryFrameMagic = 0x31465050;      // "PPF1"
+static const uint16_t kBinaryFrameVersion = 2;
+
+enum BinaryFrameType
+{
+  kBinaryTelemetry = 1,
+  kBinaryControl = 2
+};
+
+enum BinaryFrameFlags
+{
+  kBinaryFlagDelta = 1        // telemetry: answer with a delta, control: this is one
+};
+
+struct BinaryFrameHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t type;
+};
+
+struct BinaryTelemetryFrame
+{
+  BinaryFrameHeader header;
+  double x;
+  double y;
+  double s;
+  double d;
+  double yaw;
+  double speed;
+  double end_path_s;
+  double end_path_d;
+  uint32_t prev_size;
+  uint32_t num_cars;
+  uint32_t flags;
+  uint32_t seq;
+};
+
+struct BinaryControlFrame
+{
+  BinaryFrameHeader header;
+  uint32_t n;
+  uint32_t flags;
+  uint32_t base;
+  uint32_t ack_seq;
+};
+
+// doubles of one sensor fusion row in a binary telemetry frame
+static const int kBinarySensorFusionColumns = 7;
+
+#endif // BINARY_FRAME_H
@@ -0,0 +1,159 @@
+#include "control_message.h"
+
+#include <string.h>
+
+#include "binary_frame.h"
+#include "json_sax.h"
+
+ControlMessage::ControlMessage()
+  : length_(0)
+{
+}
+
+void ControlMessage::Write(const double *next_x, const double *next_y, int n)
+{
+  static const char kHead[] = "42[\"control\",{\"next_x\":";
+  static const char kMiddle[] = ",\"next_y\":";
+  static const char kTail[] = "}]";
+
+  Reserve(n);
+
+  length_ = 0;
+  Append(kHead, sizeof(kHead) - 1);
+  AppendArray(next_x, n);
+  Append(kMiddle, sizeof(kMiddle) - 1);
+  AppendArray(next_y, n);
+  Append(kTail, sizeof(kTail) - 1);
+}
+
+void ControlMessage::WriteDelta(uint32_t ack_seq, int base, const double *next_x, const double *next_y, int n)
+{
+  static const char kHead[] = "42[\"control\",{\"ack_seq\":";
+  static const char kBase[] = ",\"base\":";
+  static const char kNextX[] = ",\"next_x\":";
+  static const char kNextY[] = ",\"next_y\":";
+  static const char kTail[] = "}]";
+
+  Reserve(n + 1);
+
+  length_ = 0;
+  Append(kHead, sizeof(kHead) - 1);
+  AppendInteger(ack_seq);
+  Append(kBase, sizeof(kBase) - 1);
+  AppendInteger(base);
+  Append(kNextX, sizeof(kNextX) - 1);
+  AppendArray(next_x, n);
+  Append(kNextY, sizeof(kNextY) - 1);
+  AppendArray(next_y, n);
+  Append(kTail, sizeof(kTail) - 1);
+}
+
+void ControlMessage::WriteBinary(const double *next_x, const double *next_y, int n)
+{
+  WriteBinaryFrame(0, 0, 0, next_x, next_y, n);
+}
+
+void ControlMessage::WriteBinaryDelta(uint32_t ack_seq, int base, const double *next_x, const double *next_y, int n)
+{
+  WriteBinaryFrame(kBinaryFlagDelta, ack_seq, base, next_x, next_y, n);
+}
+
+void ControlMessage::WriteBinaryFrame(uint32_t flags, uint32_t ack_seq, int base, const double *next_x,
+                                      const double *next_y, int n)
+{
+  BinaryControlFrame frame;
+  frame.header.magic = kBinaryFrameMagic;
+  frame.header.version = kBinaryFrameVersion;
+  frame.header.type = kBinaryControl;
+  frame.n = n;
+  frame.flags = flags;
+  frame.base = base;
+  frame.ack_seq = ack_seq;
+
+  size_t capacity = sizeof(frame) + 2 * n * sizeof(double);
+  if(buffer_.size() < capacity)
+  {
+    buffer_.resize(capacity);
+  }
+
+  length_ = 0;
+  Append((const char *)&frame, sizeof(frame));
+  Append((const char *)next_x, n * sizeof(double));
+  Append((const char *)next_y, n * sizeof(double));
+}
+
+// enough for the frame around n points of the longest numbers, only grows on the first ticks
+void ControlMessage::Reserve(int n)
+{
+  size_t capacity = 64 + 2 * n * (kJsonMaxNumberLength + 1);
+  if(buffer_.size() < capacity)
+  {
+    buffer_.resize(capacity);
+  }
+}
+
+void ControlMessage::Append(const char *str, size_t len)
+{
+  memcpy(&buffer_[length_], str, len);
+  length_ += len;
+}
+
+void ControlMessage::AppendInteger(uint32_t value)
+{
+  char digits[10];
+  int n = 0;
+  do
+  {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while(value != 0);
+
+  while(n > 0)
+  {
+    buffer_[length_++] = digits[--n];
+  }
+}
+
+void ControlMessage::AppendArray(const double *values, int n)
+{
+  char *out = &buffer_[0];
+
+  out[length_++] = '[';
+  for(int i = 0; i < n; i++)
+  {
+    if(i > 0)
+    {
+      out[length_++] = ',';
+    }
+    length_ += JsonWriteNumber(values[i], out + length_);
+  }
+  out[length_++] = ']';
+}
+
+bool DecodeBinaryControl(const char *data, size_t length, std::vector<double> &next_x, std::vector<double> &next_y,
+                         bool &delta, uint32_t &base, uint32_t &ack_seq)
+{
+  BinaryControlFrame frame;
+  if(length < sizeof(frame))
+  {
+    return false;
+  }
+  memcpy(&frame, data, sizeof(frame));
+  if(frame.header.magic != kBinaryFrameMagic || frame.header.version != kBinaryFrameVersion ||
+     frame.header.type != kBinaryControl || (length - sizeof(frame)) / (2 * sizeof(double)) != frame.n ||
+     (length - sizeof(frame)) % (2 * sizeof(double)) != 0)
+  {
+    return false;
+  }
+
+  delta = (frame.flags & kBinaryFlagDelta) != 0;
+  base = frame.base;
+  ack_seq = frame.ack_seq;
+
+  next_x.resize(frame.n);
+  next_y.resize(frame.n);
+  memcpy(next_x.data(), data + sizeof(frame), frame.n * sizeof(double));
+  memcpy(next_y.data(), data + sizeof(frame) + frame.n * sizeof(double), frame.n * sizeof(double));
+
+  return true;
+}
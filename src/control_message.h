@@ -0,0 +1,61 @@
+#ifndef CONTROL_MESSAGE_H
+#define CONTROL_MESSAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// writer for the control event the planner answers every telemetry frame with,
+//
+//   42["control",{"next_x":[...],"next_y":[...]}]
+//
+// the same text json.hpp's dump() produced, with every number in its shortest
+// form that reads back exactly. the frame is written into a buffer owned by
+// the writer and reused from tick to tick, so after the first ticks nothing is
+// allocated. keep one writer per connection. connections that speak the
+// binary protocol get the fixed-layout control frame of binary_frame.h instead.
+//
+// clients that ask for it get a delta instead of the whole path,
+//
+//   42["control",{"ack_seq":7,"base":47,"next_x":[...],"next_y":[...]}]
+//
+// the path goes on from the first base points of the previous path the
+// client sent with telemetry seq 7, next_x and next_y only hold the points
+// appended to them.
+class ControlMessage
+{
+public:
+  ControlMessage();
+
+  // write the frame for the n points of the next path, replaces the previous frame
+  void Write(const double *next_x, const double *next_y, int n);
+
+  // the n points appended to the first base points of the previous path
+  void WriteDelta(uint32_t ack_seq, int base, const double *next_x, const double *next_y, int n);
+
+  // the same as binary control frames
+  void WriteBinary(const double *next_x, const double *next_y, int n);
+  void WriteBinaryDelta(uint32_t ack_seq, int base, const double *next_x, const double *next_y, int n);
+
+  // the frame, valid until the next Write
+  const char *data() const { return buffer_.data(); }
+  size_t length() const { return length_; }
+
+private:
+  void Reserve(int n);
+  void Append(const char *str, size_t len);
+  void AppendInteger(uint32_t value);
+  void AppendArray(const double *values, int n);
+  void WriteBinaryFrame(uint32_t flags, uint32_t ack_seq, int base, const double *next_x, const double *next_y, int n);
+
+  std::vector<char> buffer_;
+  size_t length_;
+};
+
+// read the points back out of a binary control frame, for clients. delta is
+// set for a delta frame, with the base and ack_seq it continues from. false if
+// the frame is not a complete binary control frame.
+bool DecodeBinaryControl(const char *data, size_t length, std::vector<double> &next_x, std::vector<double> &next_y,
+                         bool &delta, uint32_t &base, uint32_t &ack_seq);
+
+#endif // CONTROL_MESSAGE_H
@@ -0,0 +1,68 @@
+#include "frame_arena.h"
+
+#include <stdint.h>
+
+#include <new>
+
+using namespace std;
+
+FrameArena::FrameArena(size_t capacity)
+  : block_(NULL), end_(NULL), next_(NULL), used_(0), high_water_(0), overflows_(0)
+{
+  block_ = static_cast<char *>(::operator new(capacity));
+  end_ = block_ + capacity;
+  next_ = block_;
+
+  // room for the overflow blocks of a few frames, so tracking them doesn't allocate
+  overflow_.reserve(16);
+}
+
+FrameArena::~FrameArena()
+{
+  Reset();
+  ::operator delete(block_);
+}
+
+void *FrameArena::Allocate(size_t bytes, size_t align)
+{
+  uintptr_t aligned = ((uintptr_t)next_ + align - 1) & ~(uintptr_t)(align - 1);
+  used_ += bytes + (aligned - (uintptr_t)next_);
+
+  if(aligned + bytes <= (uintptr_t)end_)
+  {
+    next_ = (char *)aligned + bytes;
+    return (void *)aligned;
+  }
+
+  // the block is full, this frame goes on with the heap
+  void *ptr = ::operator new(bytes);
+  overflow_.push_back(ptr);
+  overflows_++;
+  return ptr;
+}
+
+void FrameArena::Reset()
+{
+  if(used_ > high_water_)
+  {
+    high_water_ = used_;
+  }
+
+  if(!overflow_.empty())
+  {
+    for(size_t i = 0; i < overflow_.size(); i++)
+    {
+      ::operator delete(overflow_[i]);
+    }
+    overflow_.clear();
+
+    // grow the block so the next frame like this one fits, with some slack
+    size_t capacity = high_water_ + high_water_ / 2;
+    ::operator delete(block_);
+    block_ = static_cast<char *>(::operator new(capacity));
+    end_ = block_ + capacity;
+  }
+
+  next_ = block_;
+  used_ = 0;
+}
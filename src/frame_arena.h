@@ -0,0 +1,77 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+// monotonic arena for the temporaries of planning one frame. allocations bump
+// a pointer through one block and are never freed one by one, Reset() at the
+// end of the frame gives all of them back at once. a frame that doesn't fit
+// takes its overflow from the heap, the next Reset() grows the block to the
+// largest frame seen, so after warm-up a frame makes no heap allocations.
+class FrameArena
+{
+public:
+  explicit FrameArena(size_t capacity = 64 * 1024);
+  ~FrameArena();
+
+  // bytes aligned to align, which is a power of two
+  void *Allocate(size_t bytes, size_t align);
+
+  // release everything allocated since the last reset
+  void Reset();
+
+  // bytes handed out in the current frame and the most any frame took
+  size_t used() const { return used_; }
+  size_t high_water() const { return high_water_; }
+  size_t capacity() const { return end_ - block_; }
+  // allocations that didn't fit the block and went to the heap
+  size_t overflows() const { return overflows_; }
+
+private:
+  FrameArena(const FrameArena &);
+  FrameArena &operator=(const FrameArena &);
+
+  char *block_;
+  char *end_;
+  char *next_;
+
+  // heap blocks of the current frame, freed on reset
+  std::vector<void *> overflow_;
+
+  size_t used_;
+  size_t high_water_;
+  size_t overflows_;
+};
+
+// standard allocator over a FrameArena, deallocate is a no-op. containers
+// using it must not outlive the frame.
+template <class T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(FrameArena *arena) : arena_(arena) {}
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena()) {}
+
+  T *allocate(size_t n) { return static_cast<T *>(arena_->Allocate(n * sizeof(T), alignof(T))); }
+  void deallocate(T *, size_t) {}
+
+  FrameArena *arena() const { return arena_; }
+
+private:
+  FrameArena *arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() == b.arena(); }
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() != b.arena(); }
+
+// vector whose storage lives in a FrameArena
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+#endif // FRAME_ARENA_H
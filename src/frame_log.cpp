@@ -0,0 +1,189 @@
+#include "frame_log.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// stdio buffer of the recorder, a few seconds of telemetry
+static const size_t kRecorderBufferSize = 1 << 20;
+
+FrameRecorder::FrameRecorder()
+  : file_(NULL), frames_(0)
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+  Close();
+}
+
+bool FrameRecorder::Open(const string &path)
+{
+  Close();
+  error_.clear();
+
+  file_ = fopen(path.c_str(), "wb");
+  if(file_ == NULL)
+  {
+    error_ = "can't create " + path;
+    return false;
+  }
+  setvbuf(file_, NULL, _IOFBF, kRecorderBufferSize);
+
+  FrameLogHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kFrameLogMagic, sizeof(kFrameLogMagic));
+  header.version = kFrameLogVersion;
+  header.start_time_us = chrono::duration_cast<chrono::microseconds>(
+    chrono::system_clock::now().time_since_epoch()).count();
+
+  if(fwrite(&header, sizeof(header), 1, file_) != 1)
+  {
+    error_ = "can't write " + path;
+    Close();
+    return false;
+  }
+
+  start_ = chrono::steady_clock::now();
+  frames_ = 0;
+
+  return true;
+}
+
+void FrameRecorder::Close()
+{
+  if(file_ != NULL)
+  {
+    fclose(file_);
+  }
+  file_ = NULL;
+}
+
+void FrameRecorder::Write(uint32_t connection, uint32_t opcode, const char *data, size_t length)
+{
+  if(file_ == NULL)
+  {
+    return;
+  }
+
+  FrameLogRecord record;
+  record.timestamp_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_).count();
+  record.connection = connection;
+  record.opcode = opcode;
+  record.length = length;
+  record.reserved = 0;
+
+  fwrite(&record, sizeof(record), 1, file_);
+  fwrite(data, 1, length, file_);
+  frames_++;
+}
+
+void FrameRecorder::Flush()
+{
+  if(file_ != NULL)
+  {
+    fflush(file_);
+  }
+}
+
+FrameLog::FrameLog()
+  : data_(MAP_FAILED), length_(0), header_(NULL), offset_(0)
+{
+}
+
+FrameLog::~FrameLog()
+{
+  Close();
+}
+
+bool FrameLog::Open(const string &path)
+{
+  Close();
+  error_.clear();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    error_ = "can't open " + path;
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FrameLogHeader))
+  {
+    close(fd);
+    error_ = path + " is too short for a frame log";
+    return false;
+  }
+
+  length_ = st.st_size;
+  data_ = mmap(NULL, length_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(data_ == MAP_FAILED)
+  {
+    error_ = "can't map " + path;
+    return false;
+  }
+
+  header_ = (const FrameLogHeader *)data_;
+
+  if(memcmp(header_->magic, kFrameLogMagic, sizeof(kFrameLogMagic)) != 0)
+  {
+    error_ = path + " is not a frame log";
+  }
+  else if(header_->version != kFrameLogVersion)
+  {
+    error_ = path + " has an unsupported frame log version";
+  }
+
+  if(!error_.empty())
+  {
+    Close();
+    return false;
+  }
+
+  Rewind();
+  return true;
+}
+
+void FrameLog::Close()
+{
+  if(data_ != MAP_FAILED)
+  {
+    munmap(data_, length_);
+  }
+  data_ = MAP_FAILED;
+  length_ = 0;
+  header_ = NULL;
+  offset_ = 0;
+}
+
+bool FrameLog::Next(FrameLogRecord &record, const char *&data)
+{
+  if(header_ == NULL || length_ - offset_ < sizeof(FrameLogRecord))
+  {
+    return false;
+  }
+
+  // records follow their payloads without alignment
+  const char *base = (const char *)data_;
+  memcpy(&record, base + offset_, sizeof(record));
+  if(length_ - offset_ - sizeof(record) < record.length)
+  {
+    return false;
+  }
+
+  data = base + offset_ + sizeof(record);
+  offset_ += sizeof(record) + record.length;
+
+  return true;
+}
+
+void FrameLog::Rewind()
+{
+  offset_ = sizeof(FrameLogHeader);
+}
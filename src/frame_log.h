@@ -0,0 +1,112 @@
+#ifndef FRAME_LOG_H
+#define FRAME_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+
+// compact binary log of the raw websocket frames the planner receives, so a
+// drive can be replayed offline through the same planning code.
+//
+// layout: a FrameLogHeader followed by one FrameLogRecord per frame, each
+// directly followed by its length payload bytes. little-endian, no padding
+// between records. a log cut short by a crash ends at its last complete record.
+
+static const char kFrameLogMagic[8] = {'P', 'P', 'F', 'L', 'O', 'G', 0, 0};
+static const uint32_t kFrameLogVersion = 1;
+
+// the websocket opcode of a frame
+enum FrameOpcode
+{
+  kFrameText = 1,
+  kFrameBinary = 2
+};
+
+struct FrameLogHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  // wall clock time the recording started, microseconds since the epoch
+  uint64_t start_time_us;
+};
+
+struct FrameLogRecord
+{
+  // time the frame arrived, nanoseconds since the recording started
+  uint64_t timestamp_ns;
+  // connection the frame arrived on, numbered from 0 in connection order
+  uint32_t connection;
+  uint32_t opcode;
+  uint32_t length;
+  uint32_t reserved;
+};
+
+// appends frames to a log file. writes are buffered, the file is complete
+// once Close is called or the recorder is destroyed.
+class FrameRecorder
+{
+public:
+  FrameRecorder();
+  ~FrameRecorder();
+
+  // create or truncate the log, false with error() set on failure
+  bool Open(const std::string &path);
+  void Close();
+
+  bool is_open() const { return file_ != NULL; }
+  const std::string &error() const { return error_; }
+
+  // record one frame, stamped with the time of the call
+  void Write(uint32_t connection, uint32_t opcode, const char *data, size_t length);
+
+  // push buffered frames to the file, e.g. when a connection ends
+  void Flush();
+
+  // frames written since Open
+  uint64_t frames() const { return frames_; }
+
+private:
+  FrameRecorder(const FrameRecorder &);
+  FrameRecorder &operator=(const FrameRecorder &);
+
+  FILE *file_;
+  std::chrono::steady_clock::time_point start_;
+  uint64_t frames_;
+  std::string error_;
+};
+
+// read-only memory mapping of a frame log, read front to back
+class FrameLog
+{
+public:
+  FrameLog();
+  ~FrameLog();
+
+  // map the log and check the header, false with error() set on failure
+  bool Open(const std::string &path);
+  void Close();
+
+  const std::string &error() const { return error_; }
+  const FrameLogHeader &header() const { return *header_; }
+
+  // the next frame, its payload points into the mapping. false at the end of the log.
+  bool Next(FrameLogRecord &record, const char *&data);
+
+  // start again from the first frame
+  void Rewind();
+
+private:
+  FrameLog(const FrameLog &);
+  FrameLog &operator=(const FrameLog &);
+
+  void *data_;
+  size_t length_;
+  const FrameLogHeader *header_;
+  size_t offset_;
+  std::string error_;
+};
+
+#endif // FRAME_LOG_H
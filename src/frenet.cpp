@@ -0,0 +1,192 @@
+#include "frenet.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// calculate distance between two points
+double distance(double x1, double y1, double x2, double y2)
+{
+	return sqrt((x2-x1)*(x2-x1)+(y2-y1)*(y2-y1));
+}
+
+// closest waypoint in map next to point (x,y)
+int ClosestWaypoint(double x, double y, const WaypointKdTree &maps_tree)
+{
+
+	return maps_tree.Closest(x,y);
+
+}
+
+// next waypoint in positive s-direction, given the waypoint closest to (x,y)
+int NextWaypoint(int closestWaypoint, double x, double y, double theta, const vector<double> &maps_x, const vector<double> &maps_y)
+{
+
+	double map_x = maps_x[closestWaypoint];
+	double map_y = maps_y[closestWaypoint];
+
+	double heading = atan2((map_y-y),(map_x-x));
+
+	double angle = fabs(theta-heading);
+  angle = min(2*pi() - angle, angle);
+
+  if(angle > pi()/4)
+  {
+    closestWaypoint++;
+  if (closestWaypoint == (int)maps_x.size())
+  {
+    closestWaypoint = 0;
+  }
+  }
+
+  return closestWaypoint;
+}
+
+// next waypoint in positive s-direction in map next to point (x,y)
+int NextWaypoint(double x, double y, double theta, const vector<double> &maps_x, const vector<double> &maps_y, const WaypointKdTree &maps_tree)
+{
+
+	int closestWaypoint = ClosestWaypoint(x,y,maps_tree);
+
+	return NextWaypoint(closestWaypoint,x,y,theta,maps_x,maps_y);
+}
+
+// path length from waypoint 0 up to every waypoint, computed once at load time
+vector<double> CumulativeDistance(const vector<double> &maps_x, const vector<double> &maps_y)
+{
+	vector<double> cum_s(maps_x.size(), 0);
+
+	for(size_t i = 1; i < maps_x.size(); i++)
+	{
+		cum_s[i] = cum_s[i-1] + distance(maps_x[i-1],maps_y[i-1],maps_x[i],maps_y[i]);
+	}
+
+	return cum_s;
+}
+
+// Frenet s,d of (x,y) projected onto the segment that ends at waypoint next_wp
+vector<double> getFrenetOnSegment(double x, double y, int next_wp, const vector<double> &maps_x, const vector<double> &maps_y, const vector<double> &maps_cum_s)
+{
+	int prev_wp;
+	prev_wp = next_wp-1;
+	if(next_wp == 0)
+	{
+		prev_wp  = maps_x.size()-1;
+	}
+
+	double n_x = maps_x[next_wp]-maps_x[prev_wp];
+	double n_y = maps_y[next_wp]-maps_y[prev_wp];
+	double x_x = x - maps_x[prev_wp];
+	double x_y = y - maps_y[prev_wp];
+
+	// find the projection of x onto n
+	double proj_norm = (x_x*n_x+x_y*n_y)/(n_x*n_x+n_y*n_y);
+	double proj_x = proj_norm*n_x;
+	double proj_y = proj_norm*n_y;
+
+	double frenet_d = distance(x_x,x_y,proj_x,proj_y);
+
+	//see if d value is positive or negative by comparing it to a center point
+
+	double center_x = 1000-maps_x[prev_wp];
+	double center_y = 2000-maps_y[prev_wp];
+	double centerToPos = distance(center_x,center_y,x_x,x_y);
+	double centerToRef = distance(center_x,center_y,proj_x,proj_y);
+
+	if(centerToPos <= centerToRef)
+	{
+		frenet_d *= -1;
+	}
+
+	// calculate s value
+	double frenet_s = maps_cum_s[prev_wp];
+
+	frenet_s += distance(0,0,proj_x,proj_y);
+
+	return {frenet_s,frenet_d};
+
+}
+
+// transform from Cartesian x,y coordinates to Frenet s,d coordinates
+vector<double> getFrenet(double x, double y, double theta, const vector<double> &maps_x, const vector<double> &maps_y, const vector<double> &maps_cum_s, const WaypointKdTree &maps_tree)
+{
+	int next_wp = NextWaypoint(x,y, theta, maps_x,maps_y,maps_tree);
+
+	return getFrenetOnSegment(x,y,next_wp,maps_x,maps_y,maps_cum_s);
+}
+
+// wrap s around the track into [0, max_s)
+double WrapS(double s, double max_s)
+{
+	s = fmod(s, max_s);
+	if(s < 0)
+	{
+		s += max_s;
+	}
+
+	return s;
+}
+
+// last waypoint at or before the wrapped s, the last waypoint for s before the first one
+int PrevWaypoint(double s, const vector<double> &maps_s)
+{
+	// binary search for the last waypoint at or before s
+	int prev_wp = (upper_bound(maps_s.begin(), maps_s.end(), s) - maps_s.begin()) - 1;
+
+	// s before the first waypoint lies on the segment from the last waypoint back to the first one
+	if(prev_wp < 0)
+	{
+		prev_wp = maps_s.size()-1;
+	}
+
+	return prev_wp;
+}
+
+// true if the wrapped s lies on the segment that starts at waypoint prev_wp
+bool SegmentContains(int prev_wp, double s, const vector<double> &maps_s)
+{
+	if(prev_wp == (int)maps_s.size()-1)
+	{
+		return s >= maps_s[prev_wp] || s < maps_s[0];
+	}
+
+	return s >= maps_s[prev_wp] && s < maps_s[prev_wp+1];
+}
+
+// Cartesian x,y of the wrapped s and d on the segment that starts at waypoint prev_wp
+vector<double> getXYOnSegment(int prev_wp, double s, double d, const vector<double> &maps_s, const vector<double> &maps_x, const vector<double> &maps_y, double max_s)
+{
+	int wp2 = (prev_wp+1)%maps_x.size();
+
+	double heading = atan2((maps_y[wp2]-maps_y[prev_wp]),(maps_x[wp2]-maps_x[prev_wp]));
+	// the x,y,s along the segment
+	double seg_s = (s-maps_s[prev_wp]);
+
+	// the closing segment continues past max_s
+	if(seg_s < 0)
+	{
+		seg_s += max_s;
+	}
+
+	double seg_x = maps_x[prev_wp]+seg_s*cos(heading);
+	double seg_y = maps_y[prev_wp]+seg_s*sin(heading);
+
+	double perp_heading = heading-pi()/2;
+
+	double x = seg_x + d*cos(perp_heading);
+	double y = seg_y + d*sin(perp_heading);
+
+	return {x,y};
+
+}
+
+// transform from Frenet s,d coordinates to Cartesian x,y
+vector<double> getXY(double s, double d, const vector<double> &maps_s, const vector<double> &maps_x, const vector<double> &maps_y, double max_s)
+{
+	s = WrapS(s, max_s);
+
+	int prev_wp = PrevWaypoint(s, maps_s);
+
+	return getXYOnSegment(prev_wp,s,d,maps_s,maps_x,maps_y,max_s);
+
+}
@@ -0,0 +1,48 @@
+#ifndef FRENET_H
+#define FRENET_H
+
+#include <math.h>
+#include <vector>
+
+#include "waypoint_kdtree.h"
+
+// pi for converting back and forth between radians and degrees.
+constexpr double pi() { return M_PI; }
+
+// calculate distance between two points
+double distance(double x1, double y1, double x2, double y2);
+
+// closest waypoint in map next to point (x,y)
+int ClosestWaypoint(double x, double y, const WaypointKdTree &maps_tree);
+
+// next waypoint in positive s-direction, given the waypoint closest to (x,y)
+int NextWaypoint(int closestWaypoint, double x, double y, double theta, const std::vector<double> &maps_x, const std::vector<double> &maps_y);
+
+// next waypoint in positive s-direction in map next to point (x,y)
+int NextWaypoint(double x, double y, double theta, const std::vector<double> &maps_x, const std::vector<double> &maps_y, const WaypointKdTree &maps_tree);
+
+// path length from waypoint 0 up to every waypoint, computed once at load time
+std::vector<double> CumulativeDistance(const std::vector<double> &maps_x, const std::vector<double> &maps_y);
+
+// Frenet s,d of (x,y) projected onto the segment that ends at waypoint next_wp
+std::vector<double> getFrenetOnSegment(double x, double y, int next_wp, const std::vector<double> &maps_x, const std::vector<double> &maps_y, const std::vector<double> &maps_cum_s);
+
+// transform from Cartesian x,y coordinates to Frenet s,d coordinates
+std::vector<double> getFrenet(double x, double y, double theta, const std::vector<double> &maps_x, const std::vector<double> &maps_y, const std::vector<double> &maps_cum_s, const WaypointKdTree &maps_tree);
+
+// wrap s around the track into [0, max_s)
+double WrapS(double s, double max_s);
+
+// last waypoint at or before the wrapped s, the last waypoint for s before the first one
+int PrevWaypoint(double s, const std::vector<double> &maps_s);
+
+// true if the wrapped s lies on the segment that starts at waypoint prev_wp
+bool SegmentContains(int prev_wp, double s, const std::vector<double> &maps_s);
+
+// Cartesian x,y of the wrapped s and d on the segment that starts at waypoint prev_wp
+std::vector<double> getXYOnSegment(int prev_wp, double s, double d, const std::vector<double> &maps_s, const std::vector<double> &maps_x, const std::vector<double> &maps_y, double max_s);
+
+// transform from Frenet s,d coordinates to Cartesian x,y
+std::vector<double> getXY(double s, double d, const std::vector<double> &maps_s, const std::vector<double> &maps_x, const std::vector<double> &maps_y, double max_s);
+
+#endif // FRENET_H
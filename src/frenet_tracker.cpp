@@ -0,0 +1,230 @@
+#include "frenet_tracker.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+using namespace std;
+
+// how many waypoints the search may walk away from the hint before giving up,
+// at least. on dense maps it may walk as far as kMaxHintTravel instead.
+static const int kMaxHintSteps = 4;
+
+// how far along the track an object may move between two lookups and still be
+// found from its hint, four frames of a car at 25 m/s
+static const double kMaxHintTravel = 2.0;
+
+// how far from the road center a point may be for the walk to trust a local
+// minimum, the three 4 m lanes and a margin
+static const double kMaxRoadOffset = 16.0;
+
+FrenetTracker::FrenetTracker(const HighwayMap &map)
+  : map_(map), max_steps_(kMaxHintSteps), hits_(0), misses_(0)
+{
+  if(map.size() > 0)
+  {
+    double spacing = map.max_s() / map.size();
+    max_steps_ = max(kMaxHintSteps, (int)ceil(kMaxHintTravel / spacing));
+  }
+}
+
+void FrenetTracker::getFrenet(int id, double x, double y, double theta, double &s, double &d)
+{
+  Hint &hint = hints_[id];
+
+  int closest_wp = -1;
+  if(hint.closest_wp >= 0)
+  {
+    closest_wp = ClosestFrom(hint.closest_wp, x, y);
+  }
+
+  if(closest_wp >= 0)
+  {
+    hits_++;
+  }
+  else
+  {
+    misses_++;
+    closest_wp = map_.ClosestWaypoint(x, y);
+  }
+  hint.closest_wp = closest_wp;
+
+  int next_wp = map_.NextWaypoint(closest_wp, x, y, theta);
+
+  map_.getFrenetOnSegment(x, y, next_wp, s, d);
+}
+
+void FrenetTracker::getXY(int id, double s, double d, double &x, double &y)
+{
+  Hint &hint = hints_[id];
+
+  s = map_.WrapS(s);
+
+  int prev_wp = -1;
+  if(hint.prev_wp >= 0)
+  {
+    prev_wp = SegmentFrom(hint.prev_wp, s);
+  }
+
+  if(prev_wp >= 0)
+  {
+    hits_++;
+  }
+  else
+  {
+    misses_++;
+    prev_wp = map_.PrevWaypoint(s);
+  }
+  hint.prev_wp = prev_wp;
+
+  map_.getXYOnSegment(prev_wp, s, d, x, y);
+}
+
+void FrenetTracker::Forget(int id)
+{
+  hints_.erase(id);
+}
+
+// walk downhill in squared distance from waypoint wp to the closest waypoint.
+// returns -1 if the walk does not settle within max_steps_ or if the point is
+// too far from the road for a local minimum to be trusted.
+int FrenetTracker::ClosestFrom(int wp, double x, double y) const
+{
+  int n = map_.size();
+  const double *map_x = map_.x();
+  const double *map_y = map_.y();
+  const double *length = map_.length();
+
+  double dx = map_x[wp] - x;
+  double dy = map_y[wp] - y;
+  double best_dist2 = dx*dx + dy*dy;
+
+  for(int step = 0; step <= max_steps_; step++)
+  {
+    int next = (wp + 1) % n;
+    int prev = (wp + n - 1) % n;
+
+    dx = map_x[next] - x;
+    dy = map_y[next] - y;
+    double next_dist2 = dx*dx + dy*dy;
+
+    dx = map_x[prev] - x;
+    dy = map_y[prev] - y;
+    double prev_dist2 = dx*dx + dy*dy;
+
+    if(next_dist2 < best_dist2 && next_dist2 <= prev_dist2)
+    {
+      wp = next;
+      best_dist2 = next_dist2;
+    }
+    else if(prev_dist2 < best_dist2)
+    {
+      wp = prev;
+      best_dist2 = prev_dist2;
+    }
+    else
+    {
+      // a point on the road is never further from its closest waypoint than
+      // the longer of the two segments next to it and its offset from the
+      // center. on dense maps the offset is most of it.
+      double max_seg = max(length[wp], length[prev]);
+      double max_dist = max_seg + kMaxRoadOffset;
+      if(best_dist2 > max_dist*max_dist)
+      {
+        return -1;
+      }
+
+      return ClosestNear(wp, x, y, 2*sqrt(best_dist2) + max_seg);
+    }
+  }
+
+  return -1;
+}
+
+// the closest waypoint to x,y within reach meters along the track of waypoint
+// wp. inside a bend a point has a foot on the road before and after the bend,
+// and a walk downhill may settle on the farther one. the closest waypoint is
+// never more than twice the distance to wp away from wp, so a reach of that
+// finds it. a waypoint dist from x,y is followed by none closer than best for
+// the next dist - best meters of track, those are skipped unmeasured.
+int FrenetTracker::ClosestNear(int wp, double x, double y, double reach) const
+{
+  int n = map_.size();
+  const double *map_x = map_.x();
+  const double *map_y = map_.y();
+  const double *length = map_.length();
+
+  double dx = map_x[wp] - x;
+  double dy = map_y[wp] - y;
+  double best_dist = sqrt(dx*dx + dy*dy);
+  int best_wp = wp;
+
+  // ahead of wp, then behind it
+  for(int dir = 1; dir >= -1; dir -= 2)
+  {
+    double walked = 0;
+    double next_check = 0;
+    int i = wp;
+    for(int step = 1; step < n; step++)
+    {
+      if(dir > 0)
+      {
+        walked += length[i];
+        i = (i + 1 < n) ? i + 1 : 0;
+      }
+      else
+      {
+        i = (i > 0) ? i - 1 : n - 1;
+        walked += length[i];
+      }
+      if(walked > reach)
+      {
+        break;
+      }
+      if(walked < next_check)
+      {
+        continue;
+      }
+
+      dx = map_x[i] - x;
+      dy = map_y[i] - y;
+      double dist = sqrt(dx*dx + dy*dy);
+      if(dist < best_dist)
+      {
+        best_dist = dist;
+        best_wp = i;
+      }
+      next_check = walked + (dist - best_dist);
+    }
+  }
+
+  return best_wp;
+}
+
+// step from segment wp towards the wrapped s, -1 if s is not within max_steps_ segments
+int FrenetTracker::SegmentFrom(int wp, double s) const
+{
+  int n = map_.size();
+
+  if(map_.SegmentContains(wp, s))
+  {
+    return wp;
+  }
+
+  for(int step = 1; step <= max_steps_; step++)
+  {
+    int ahead = (wp + step) % n;
+    if(map_.SegmentContains(ahead, s))
+    {
+      return ahead;
+    }
+
+    int behind = (wp + n - step) % n;
+    if(map_.SegmentContains(behind, s))
+    {
+      return behind;
+    }
+  }
+
+  return -1;
+}
@@ -0,0 +1,58 @@
+#ifndef FRENET_TRACKER_H
+#define FRENET_TRACKER_H
+
+#include <unordered_map>
+
+#include "highway_map.h"
+
+// stateful Frenet converter for objects that are tracked from frame to frame.
+// the waypoint found for an object id is remembered, and the next conversion
+// for that id searches outward from it. telemetry frames are only 20 ms apart,
+// so this almost always ends within a few waypoints, however dense the map,
+// and the global search is only needed on a miss.
+class FrenetTracker
+{
+public:
+  // id used for the ego car, sensor fusion ids are non-negative
+  static const int kEgoId = -1;
+
+  explicit FrenetTracker(const HighwayMap &map);
+
+  // transform from Cartesian x,y coordinates to Frenet s,d coordinates
+  void getFrenet(int id, double x, double y, double theta, double &s, double &d);
+
+  // transform from Frenet s,d coordinates to Cartesian x,y
+  void getXY(int id, double s, double d, double &x, double &y);
+
+  // drop the remembered waypoints of an object that left the scene
+  void Forget(int id);
+
+  // number of lookups answered from the hint, and falling back to the global search
+  long hits() const { return hits_; }
+  long misses() const { return misses_; }
+
+private:
+  // the remembered waypoints of one object
+  struct Hint
+  {
+    Hint() : closest_wp(-1), prev_wp(-1) {}
+    int closest_wp;     // closest waypoint of the last getFrenet
+    int prev_wp;        // segment start of the last getXY
+  };
+
+  int ClosestFrom(int wp, double x, double y) const;
+  int ClosestNear(int wp, double x, double y, double reach) const;
+  int SegmentFrom(int wp, double s) const;
+
+  const HighwayMap &map_;
+
+  // how many waypoints a search may walk from the hint, set from the spacing
+  int max_steps_;
+
+  std::unordered_map<int, Hint> hints_;
+
+  long hits_;
+  long misses_;
+};
+
+#endif // FRENET_TRACKER_H
@@ -0,0 +1,331 @@
+#include "highway_map.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include "frenet.h"
+
+using namespace std;
+
+HighwayMap::HighwayMap()
+  : owned_image_(NULL), image_size_(0), size_(0), max_s_(0)
+{
+  memset(section_, 0, sizeof(section_));
+}
+
+HighwayMap::~HighwayMap()
+{
+  Release();
+}
+
+void HighwayMap::Build(const MapWaypoints &waypoints, double max_s)
+{
+  Release();
+
+  int n = waypoints.x.size();
+
+  MapFileHeader header;
+  image_size_ = MapFileLayout(n, max_s, header);
+
+  if(posix_memalign(&owned_image_, kMapSectionAlign, image_size_) != 0)
+  {
+    owned_image_ = NULL;
+    image_size_ = 0;
+    return;
+  }
+  memset(owned_image_, 0, image_size_);
+  memcpy(owned_image_, &header, sizeof(header));
+
+  char *image = (char *)owned_image_;
+  double *map_x = (double *)(image + header.section_offset[kSectionX]);
+  double *map_y = (double *)(image + header.section_offset[kSectionY]);
+  double *map_s = (double *)(image + header.section_offset[kSectionS]);
+  double *map_dx = (double *)(image + header.section_offset[kSectionDx]);
+  double *map_dy = (double *)(image + header.section_offset[kSectionDy]);
+  double *cum_s = (double *)(image + header.section_offset[kSectionCumS]);
+  double *length = (double *)(image + header.section_offset[kSectionLength]);
+  double *heading = (double *)(image + header.section_offset[kSectionHeading]);
+  double *tangent_x = (double *)(image + header.section_offset[kSectionTangentX]);
+  double *tangent_y = (double *)(image + header.section_offset[kSectionTangentY]);
+  double *normal_x = (double *)(image + header.section_offset[kSectionNormalX]);
+  double *normal_y = (double *)(image + header.section_offset[kSectionNormalY]);
+  int32_t *tree_index = (int32_t *)(image + header.section_offset[kSectionTreeIndex]);
+  double *tree_x = (double *)(image + header.section_offset[kSectionTreeX]);
+  double *tree_y = (double *)(image + header.section_offset[kSectionTreeY]);
+
+  copy(waypoints.x.begin(), waypoints.x.end(), map_x);
+  copy(waypoints.y.begin(), waypoints.y.end(), map_y);
+  copy(waypoints.s.begin(), waypoints.s.end(), map_s);
+  copy(waypoints.dx.begin(), waypoints.dx.end(), map_dx);
+  copy(waypoints.dy.begin(), waypoints.dy.end(), map_dy);
+
+  for(int i = 0; i < n; i++)
+  {
+    int next = (i + 1) % n;
+    length[i] = distance(map_x[i], map_y[i], map_x[next], map_y[next]);
+    heading[i] = atan2(map_y[next] - map_y[i], map_x[next] - map_x[i]);
+
+    // unit tangent along the segment and unit normal to its right (heading - pi/2),
+    // the direction getXY offsets d into
+    tangent_x[i] = (map_x[next] - map_x[i]) / length[i];
+    tangent_y[i] = (map_y[next] - map_y[i]) / length[i];
+    normal_x[i] = tangent_y[i];
+    normal_y[i] = -tangent_x[i];
+  }
+
+  // summed in the same order as CumulativeDistance
+  cum_s[0] = 0;
+  for(int i = 1; i < n; i++)
+  {
+    cum_s[i] = cum_s[i-1] + length[i-1];
+  }
+
+  WaypointKdTree tree;
+  tree.Build(map_x, map_y, n);
+  copy(tree.index(), tree.index() + n, tree_index);
+  copy(tree.x(), tree.x() + n, tree_x);
+  copy(tree.y(), tree.y() + n, tree_y);
+
+  Attach(owned_image_);
+}
+
+bool HighwayMap::Open(const string &path, string &error)
+{
+  Release();
+
+  if(!file_.Open(path))
+  {
+    error = file_.error();
+    return false;
+  }
+
+  image_size_ = file_.length();
+  Attach(file_.data());
+
+  return true;
+}
+
+bool HighwayMap::Save(const string &path) const
+{
+  const void *image = owned_image_ ? owned_image_ : file_.data();
+  if(image == NULL)
+  {
+    return false;
+  }
+
+  ofstream out(path.c_str(), ofstream::binary | ofstream::trunc);
+  out.write((const char *)image, image_size_);
+
+  return (bool)out;
+}
+
+void HighwayMap::Attach(const void *image)
+{
+  const MapFileHeader *header = (const MapFileHeader *)image;
+
+  for(int i = 0; i < kNumSections; i++)
+  {
+    section_[i] = (const char *)image + header->section_offset[i];
+  }
+  size_ = header->num_waypoints;
+  max_s_ = header->max_s;
+
+  tree_.Borrow((const int32_t *)section_[kSectionTreeIndex], Section(kSectionTreeX), Section(kSectionTreeY), size_);
+}
+
+void HighwayMap::Release()
+{
+  tree_.Borrow(NULL, NULL, NULL, 0);
+  file_.Close();
+  free(owned_image_);
+  owned_image_ = NULL;
+  image_size_ = 0;
+  memset(section_, 0, sizeof(section_));
+  size_ = 0;
+  max_s_ = 0;
+}
+
+int HighwayMap::ClosestWaypoint(double x, double y) const
+{
+  return tree_.Closest(x, y);
+}
+
+int HighwayMap::NextWaypoint(int closest_wp, double x, double y, double theta) const
+{
+  double map_x = this->x()[closest_wp];
+  double map_y = this->y()[closest_wp];
+
+  double heading = atan2((map_y-y),(map_x-x));
+
+  double angle = fabs(theta-heading);
+  angle = min(2*pi() - angle, angle);
+
+  if(angle > pi()/4)
+  {
+    closest_wp = (closest_wp + 1) % size_;
+  }
+
+  return closest_wp;
+}
+
+int HighwayMap::NextWaypoint(double x, double y, double theta) const
+{
+  return NextWaypoint(ClosestWaypoint(x, y), x, y, theta);
+}
+
+void HighwayMap::getFrenetOnSegment(double x, double y, int next_wp, double &s, double &d) const
+{
+  const double *map_x = this->x();
+  const double *map_y = this->y();
+
+  int prev_wp = (next_wp == 0) ? size_-1 : next_wp-1;
+
+  double n_x = map_x[next_wp]-map_x[prev_wp];
+  double n_y = map_y[next_wp]-map_y[prev_wp];
+  double x_x = x - map_x[prev_wp];
+  double x_y = y - map_y[prev_wp];
+
+  // find the projection of x onto n
+  double proj_norm = (x_x*n_x+x_y*n_y)/(n_x*n_x+n_y*n_y);
+  double proj_x = proj_norm*n_x;
+  double proj_y = proj_norm*n_y;
+
+  d = distance(x_x,x_y,proj_x,proj_y);
+
+  // see if d value is positive or negative by comparing it to a center point
+  double center_x = 1000-map_x[prev_wp];
+  double center_y = 2000-map_y[prev_wp];
+  double centerToPos = distance(center_x,center_y,x_x,x_y);
+  double centerToRef = distance(center_x,center_y,proj_x,proj_y);
+
+  if(centerToPos <= centerToRef)
+  {
+    d *= -1;
+  }
+
+  s = cum_s()[prev_wp] + distance(0,0,proj_x,proj_y);
+}
+
+void HighwayMap::getFrenet(double x, double y, double theta, double &s, double &d) const
+{
+  getFrenetOnSegment(x, y, NextWaypoint(x, y, theta), s, d);
+}
+
+// points per pass of getFrenetBatch, the waypoint indices of one pass live on the stack
+static const int kBatchChunk = 256;
+
+// projection step of getFrenetBatch, same steps as getFrenetOnSegment.
+// the pointers are restrict qualified parameters and the loop has no branches,
+// so the compiler vectorizes it with gathers from the waypoint arrays.
+static void ProjectBatch(const double *__restrict x, const double *__restrict y, const int *__restrict next_wp,
+                         double *__restrict s, double *__restrict d, int n,
+                         const double *__restrict maps_x, const double *__restrict maps_y,
+                         const double *__restrict maps_cum_s, int last_wp)
+{
+  for(int k = 0; k < n; k++)
+  {
+    int prev_wp = (next_wp[k] == 0) ? last_wp : next_wp[k]-1;
+
+    double n_x = maps_x[next_wp[k]]-maps_x[prev_wp];
+    double n_y = maps_y[next_wp[k]]-maps_y[prev_wp];
+    double x_x = x[k] - maps_x[prev_wp];
+    double x_y = y[k] - maps_y[prev_wp];
+
+    double proj_norm = (x_x*n_x+x_y*n_y)/(n_x*n_x+n_y*n_y);
+    double proj_x = proj_norm*n_x;
+    double proj_y = proj_norm*n_y;
+
+    double frenet_d = sqrt((proj_x-x_x)*(proj_x-x_x)+(proj_y-x_y)*(proj_y-x_y));
+
+    double center_x = 1000-maps_x[prev_wp];
+    double center_y = 2000-maps_y[prev_wp];
+    double centerToPos = sqrt((x_x-center_x)*(x_x-center_x)+(x_y-center_y)*(x_y-center_y));
+    double centerToRef = sqrt((proj_x-center_x)*(proj_x-center_x)+(proj_y-center_y)*(proj_y-center_y));
+
+    d[k] = (centerToPos <= centerToRef) ? -frenet_d : frenet_d;
+    s[k] = maps_cum_s[prev_wp] + sqrt(proj_x*proj_x+proj_y*proj_y);
+  }
+}
+
+void HighwayMap::getFrenetBatch(const double *x, const double *y, const double *theta, double *s, double *d, size_t n) const
+{
+  int next_wp[kBatchChunk];
+
+  for(size_t base = 0; base < n; base += kBatchChunk)
+  {
+    int count = min((size_t)kBatchChunk, n - base);
+
+    // the waypoint search stays scalar
+    for(int k = 0; k < count; k++)
+    {
+      next_wp[k] = NextWaypoint(x[base+k], y[base+k], theta[base+k]);
+    }
+
+    ProjectBatch(x + base, y + base, next_wp, s + base, d + base, count,
+                 this->x(), this->y(), cum_s(), size_-1);
+  }
+}
+
+double HighwayMap::WrapS(double s) const
+{
+  s = fmod(s, max_s_);
+  if(s < 0)
+  {
+    s += max_s_;
+  }
+
+  return s;
+}
+
+int HighwayMap::PrevWaypoint(double s) const
+{
+  const double *map_s = this->s();
+
+  // binary search for the last waypoint at or before s
+  int prev_wp = (upper_bound(map_s, map_s + size_, s) - map_s) - 1;
+
+  // s before the first waypoint lies on the segment from the last waypoint back to the first one
+  if(prev_wp < 0)
+  {
+    prev_wp = size_-1;
+  }
+
+  return prev_wp;
+}
+
+bool HighwayMap::SegmentContains(int prev_wp, double s) const
+{
+  const double *map_s = this->s();
+
+  if(prev_wp == size_-1)
+  {
+    return s >= map_s[prev_wp] || s < map_s[0];
+  }
+
+  return s >= map_s[prev_wp] && s < map_s[prev_wp+1];
+}
+
+void HighwayMap::getXYOnSegment(int prev_wp, double s, double d, double &x, double &y) const
+{
+  // the x,y,s along the segment, the closing segment continues past max_s
+  double seg_s = s - this->s()[prev_wp];
+  if(seg_s < 0)
+  {
+    seg_s += max_s_;
+  }
+
+  // walk along the segment tangent and offset along its normal, no trig needed
+  x = this->x()[prev_wp] + seg_s*tangent_x()[prev_wp] + d*normal_x()[prev_wp];
+  y = this->y()[prev_wp] + seg_s*tangent_y()[prev_wp] + d*normal_y()[prev_wp];
+}
+
+void HighwayMap::getXY(double s, double d, double &x, double &y) const
+{
+  s = WrapS(s);
+
+  getXYOnSegment(PrevWaypoint(s), s, d, x, y);
+}
@@ -0,0 +1,112 @@
+#ifndef HIGHWAY_MAP_H
+#define HIGHWAY_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "map_file.h"
+#include "waypoint_kdtree.h"
+
+// the track map with everything derived from it, stored as structure of arrays.
+// waypoint and per-segment data live in one 64 byte aligned image laid out like
+// the binary map file, so a map built from the csv and a mapped map file are
+// used the same way. segment i runs from waypoint i to waypoint i+1, the last
+// segment closes the loop back to waypoint 0.
+//
+// the map is read-only once built, so one instance can be shared by every
+// planner without copies.
+class HighwayMap
+{
+public:
+  HighwayMap();
+  ~HighwayMap();
+
+  // derive all per-segment data and the spatial index from the waypoints
+  void Build(const MapWaypoints &waypoints, double max_s);
+
+  // map a binary map file and use its sections in place, nothing is copied
+  bool Open(const std::string &path, std::string &error);
+
+  // write the binary map file
+  bool Save(const std::string &path) const;
+
+  int size() const { return size_; }
+  double max_s() const { return max_s_; }
+
+  // per waypoint
+  const double *x() const { return Section(kSectionX); }
+  const double *y() const { return Section(kSectionY); }
+  const double *s() const { return Section(kSectionS); }
+  const double *dx() const { return Section(kSectionDx); }
+  const double *dy() const { return Section(kSectionDy); }
+  const double *cum_s() const { return Section(kSectionCumS); }
+
+  // per segment
+  const double *length() const { return Section(kSectionLength); }
+  const double *heading() const { return Section(kSectionHeading); }
+  const double *tangent_x() const { return Section(kSectionTangentX); }
+  const double *tangent_y() const { return Section(kSectionTangentY); }
+  const double *normal_x() const { return Section(kSectionNormalX); }
+  const double *normal_y() const { return Section(kSectionNormalY); }
+
+  const WaypointKdTree &tree() const { return tree_; }
+
+  // closest waypoint in map next to point (x,y)
+  int ClosestWaypoint(double x, double y) const;
+
+  // next waypoint in positive s-direction, given the waypoint closest to (x,y)
+  int NextWaypoint(int closest_wp, double x, double y, double theta) const;
+
+  // next waypoint in positive s-direction in map next to point (x,y)
+  int NextWaypoint(double x, double y, double theta) const;
+
+  // Frenet s,d of (x,y) projected onto the segment that ends at waypoint next_wp
+  void getFrenetOnSegment(double x, double y, int next_wp, double &s, double &d) const;
+
+  // transform from Cartesian x,y coordinates to Frenet s,d coordinates
+  void getFrenet(double x, double y, double theta, double &s, double &d) const;
+
+  // batch transform of n points from x[],y[],theta[] into the caller's s[],d[] buffers.
+  // gives the same results as getFrenet, the projection runs as a branch free loop that vectorizes.
+  // the waypoint search stays scalar and takes most of the time, map_bench times both.
+  void getFrenetBatch(const double *x, const double *y, const double *theta, double *s, double *d, size_t n) const;
+
+  // wrap s around the track into [0, max_s)
+  double WrapS(double s) const;
+
+  // segment that contains the wrapped s
+  int PrevWaypoint(double s) const;
+
+  // true if the wrapped s lies on segment prev_wp
+  bool SegmentContains(int prev_wp, double s) const;
+
+  // Cartesian x,y of the wrapped s and d on segment prev_wp
+  void getXYOnSegment(int prev_wp, double s, double d, double &x, double &y) const;
+
+  // transform from Frenet s,d coordinates to Cartesian x,y
+  void getXY(double s, double d, double &x, double &y) const;
+
+private:
+  HighwayMap(const HighwayMap &);
+  HighwayMap &operator=(const HighwayMap &);
+
+  const double *Section(MapSection section) const { return (const double *)section_[section]; }
+
+  // point the sections and the tree into a map image
+  void Attach(const void *image);
+  void Release();
+
+  // image built in memory, or the mapped map file
+  void *owned_image_;
+  uint64_t image_size_;
+  MapFile file_;
+
+  const void *section_[kNumSections];
+  int size_;
+  double max_s_;
+
+  WaypointKdTree tree_;
+};
+
+#endif // HIGHWAY_MAP_H
@@ -0,0 +1,402 @@
+#include "json_sax.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// powers of ten that are exact in a double
+static const double kPow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#if LDBL_MANT_DIG == 64
+// powers of ten that are exact in an x87 long double
+static const long double kPow10Long[] = {
+  1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L,
+  1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+};
+#endif
+
+void JsonSkipSpace(JsonCursor &c)
+{
+  while(c.p < c.end && (*c.p == ' ' || *c.p == '\t' || *c.p == '\n' || *c.p == '\r'))
+  {
+    c.p++;
+  }
+}
+
+bool JsonConsume(JsonCursor &c, char ch)
+{
+  JsonSkipSpace(c);
+  if(c.p < c.end && *c.p == ch)
+  {
+    c.p++;
+    return true;
+  }
+
+  return false;
+}
+
+bool JsonConsumeLiteral(JsonCursor &c, const char *literal)
+{
+  size_t n = strlen(literal);
+  if((size_t)(c.end - c.p) >= n && memcmp(c.p, literal, n) == 0)
+  {
+    c.p += n;
+    return true;
+  }
+
+  return false;
+}
+
+bool JsonParseString(JsonCursor &c, const char *&str, size_t &len)
+{
+  if(!JsonConsume(c, '"'))
+  {
+    return false;
+  }
+
+  str = c.p;
+  while(c.p < c.end && *c.p != '"')
+  {
+    if(*c.p == '\\')
+    {
+      c.p++;
+    }
+    c.p++;
+  }
+  if(c.p >= c.end)
+  {
+    return false;
+  }
+  len = c.p - str;
+  c.p++;
+
+  return true;
+}
+
+static bool IsDigit(char ch)
+{
+  return ch >= '0' && ch <= '9';
+}
+
+bool JsonDecimalToDouble(uint64_t mantissa, int exponent, double &value)
+{
+  // a mantissa up to 2^53 and a power of ten within 22 are both exact in a
+  // double, so the one multiplication or division rounds correctly
+  if(mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+  {
+    value = (double)mantissa;
+    value = (exponent < 0) ? value / kPow10[-exponent] : value * kPow10[exponent];
+    return true;
+  }
+
+#if LDBL_MANT_DIG == 64
+  if(exponent >= -27 && exponent <= 27)
+  {
+    // mantissa and power of ten are exact, so the result is off by at most half
+    // a long double ulp. rounding it to double is then exact as long as the 11
+    // extra bits are not right at the halfway point.
+    long double result = (long double)mantissa;
+    result = (exponent < 0) ? result / kPow10Long[-exponent] : result * kPow10Long[exponent];
+
+    // the x87 format keeps the 64 bit significand in the low 8 bytes
+    uint64_t bits;
+    memcpy(&bits, &result, sizeof(bits));
+    uint64_t extra = bits & 0x7ff;
+    if(extra < 0x3ff || extra > 0x401)
+    {
+      value = (double)result;
+      return true;
+    }
+  }
+#endif
+
+  return false;
+}
+
+// numbers of up to 19 significant digits, which covers the 17 digit path the
+// planner sent back, are converted by JsonDecimalToDouble. anything else goes
+// through strtod from a stack copy.
+bool JsonParseNumber(JsonCursor &c, double &value)
+{
+  JsonSkipSpace(c);
+  const char *start = c.p;
+
+  bool negative = (c.p < c.end && *c.p == '-');
+  if(negative)
+  {
+    c.p++;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+
+  const char *int_start = c.p;
+  while(c.p < c.end && IsDigit(*c.p))
+  {
+    if(mantissa != 0 || *c.p != '0')
+    {
+      digits++;
+    }
+    mantissa = mantissa * 10 + (*c.p - '0');
+    c.p++;
+  }
+  if(c.p == int_start)
+  {
+    return false;
+  }
+
+  if(c.p < c.end && *c.p == '.')
+  {
+    c.p++;
+    const char *frac_start = c.p;
+    while(c.p < c.end && IsDigit(*c.p))
+    {
+      if(mantissa != 0 || *c.p != '0')
+      {
+        digits++;
+      }
+      mantissa = mantissa * 10 + (*c.p - '0');
+      exponent--;
+        c.p++;
+    }
+    if(c.p == frac_start)
+    {
+      return false;
+    }
+  }
+
+  if(c.p < c.end && (*c.p == 'e' || *c.p == 'E'))
+  {
+    c.p++;
+    bool exp_negative = false;
+    if(c.p < c.end && (*c.p == '+' || *c.p == '-'))
+    {
+      exp_negative = (*c.p == '-');
+      c.p++;
+    }
+    const char *exp_start = c.p;
+    int exp_value = 0;
+    while(c.p < c.end && IsDigit(*c.p))
+    {
+      exp_value = (exp_value < 10000) ? exp_value * 10 + (*c.p - '0') : exp_value;
+      c.p++;
+    }
+    if(c.p == exp_start)
+    {
+      return false;
+    }
+    exponent += exp_negative ? -exp_value : exp_value;
+  }
+
+  double result;
+  if(digits <= 19 && JsonDecimalToDouble(mantissa, exponent, result))
+  {
+    value = negative ? -result : result;
+    return true;
+  }
+
+  char buffer[64];
+  size_t len = c.p - start;
+  if(len >= sizeof(buffer))
+  {
+    return false;
+  }
+  memcpy(buffer, start, len);
+  buffer[len] = 0;
+  value = strtod(buffer, NULL);
+
+  return true;
+}
+
+// mantissa * 10^exponent in the %g style json.hpp writes: fixed notation for
+// decimal exponents from -4 to 16, scientific otherwise, and ".0" on integers
+// so the number still reads as a float
+static int FormatDecimal(bool negative, uint64_t mantissa, int exponent, char *out)
+{
+  while(mantissa != 0 && mantissa % 10 == 0)
+  {
+    mantissa /= 10;
+    exponent++;
+  }
+
+  char digits[20];
+  int num_digits = 0;
+  do
+  {
+    digits[num_digits++] = '0' + mantissa % 10;
+    mantissa /= 10;
+  } while(mantissa != 0);
+
+  int len = 0;
+  if(negative)
+  {
+    out[len++] = '-';
+  }
+
+  // digits before the decimal point
+  int point = num_digits + exponent;
+
+  if(point > 17 || point < -3)
+  {
+    out[len++] = digits[num_digits-1];
+    if(num_digits > 1)
+    {
+      out[len++] = '.';
+      for(int i = num_digits-2; i >= 0; i--)
+      {
+        out[len++] = digits[i];
+      }
+    }
+    int exp10 = point - 1;
+    out[len++] = 'e';
+    out[len++] = (exp10 < 0) ? '-' : '+';
+    exp10 = abs(exp10);
+    if(exp10 >= 100)
+    {
+      out[len++] = '0' + exp10 / 100;
+    }
+    out[len++] = '0' + exp10 / 10 % 10;
+    out[len++] = '0' + exp10 % 10;
+  }
+  else if(point <= 0)
+  {
+    out[len++] = '0';
+    out[len++] = '.';
+    for(int i = 0; i < -point; i++)
+    {
+      out[len++] = '0';
+    }
+    for(int i = num_digits-1; i >= 0; i--)
+    {
+      out[len++] = digits[i];
+    }
+  }
+  else
+  {
+    for(int i = num_digits-1; i >= 0; i--)
+    {
+      out[len++] = digits[i];
+      if(num_digits - i == point && i > 0)
+      {
+        out[len++] = '.';
+      }
+    }
+    for(int i = num_digits; i < point; i++)
+    {
+      out[len++] = '0';
+    }
+    if(point >= num_digits)
+    {
+      out[len++] = '.';
+      out[len++] = '0';
+    }
+  }
+
+  return len;
+}
+
+#if LDBL_MANT_DIG == 64
+// mantissa * 10^exponent read by strtod, for the candidates too close to a
+// halfway point for JsonDecimalToDouble
+static double DecimalToDouble(uint64_t mantissa, int exponent)
+{
+  char buffer[kJsonMaxNumberLength];
+  snprintf(buffer, sizeof(buffer), "%llue%d", (unsigned long long)mantissa, exponent);
+  return strtod(buffer, NULL);
+}
+#endif
+
+// the candidates are 15, 16 and 17 significant digits, 17 always read back
+// exactly. at most one 15 digit decimal reads back as a given double, so when
+// it exists its trailing zeros are the only thing to drop for the shortest.
+// the digits come from one extended precision scaling that can be off by one
+// in the last place, so the neighbours are tried too, and every candidate is
+// checked with the exact JsonDecimalToDouble, or with strtod when that can't
+// decide, so a candidate is never passed over for a longer one. values out of
+// its range fall back to snprintf and strtod.
+int JsonWriteNumber(double value, char *out)
+{
+  if(!isfinite(value))
+  {
+    memcpy(out, "null", 4);
+    return 4;
+  }
+
+  bool negative = signbit(value);
+  double magnitude = fabs(value);
+  if(magnitude == 0)
+  {
+    return FormatDecimal(negative, 0, 0, out);
+  }
+
+#if LDBL_MANT_DIG == 64
+  static const int kOffsets[] = {0, -1, 1};
+
+  int exp10 = (int)floor(log10(magnitude));
+  for(int precision = 15; precision <= 17; precision++)
+  {
+    int scale = precision - 1 - exp10;
+    if(scale < -27 || scale > 27)
+    {
+      break;
+    }
+
+    long double scaled = (scale >= 0) ? magnitude * kPow10Long[scale] : magnitude / kPow10Long[-scale];
+    uint64_t mantissa = (uint64_t)(scaled + 0.5L);
+
+    for(int k = 0; k < 3; k++)
+    {
+      uint64_t candidate = mantissa + kOffsets[k];
+      if(candidate == 0)
+      {
+        continue;
+      }
+
+      double back;
+      if(!JsonDecimalToDouble(candidate, -scale, back))
+      {
+        back = DecimalToDouble(candidate, -scale);
+      }
+      if(back == magnitude)
+      {
+        return FormatDecimal(negative, candidate, -scale, out);
+      }
+    }
+  }
+#endif
+
+  char buffer[kJsonMaxNumberLength];
+  int precision;
+  for(precision = 1; precision < 17; precision++)
+  {
+    snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, magnitude);
+    if(strtod(buffer, NULL) == magnitude)
+    {
+      break;
+    }
+  }
+  if(precision == 17)
+  {
+    snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, magnitude);
+  }
+
+  // d.ddde+x
+  uint64_t mantissa = 0;
+  const char *p = buffer;
+  for(; *p != 'e'; p++)
+  {
+    if(IsDigit(*p))
+    {
+      mantissa = mantissa * 10 + (*p - '0');
+    }
+  }
+
+  return FormatDecimal(negative, mantissa, atoi(p + 1) - (precision - 1), out);
+}
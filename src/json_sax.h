@@ -0,0 +1,153 @@
+#ifndef JSON_SAX_H
+#define JSON_SAX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SAX style json reader, and number formatting for writing json. the bundled
+// json.hpp (2.1.1) has no sax_parse, so this walks a json text in place and
+// reports every value to a handler, in the spirit of nlohmann::json_sax,
+// without building a DOM. strings and keys are passed as pointer and length
+// into the text, nothing is copied and nothing is allocated.
+//
+// a handler has these members, each returns false to stop the parse:
+//
+//   bool Null();
+//   bool Boolean(bool value);
+//   bool Number(double value);
+//   bool String(const char *str, size_t len);
+//   bool StartObject();
+//   bool Key(const char *str, size_t len);
+//   bool EndObject();
+//   bool StartArray();
+//   bool EndArray();
+
+// read position in the text, never moves past end
+struct JsonCursor
+{
+  const char *p;
+  const char *end;
+};
+
+// deepest nesting JsonSaxParse follows
+static const int kJsonMaxDepth = 32;
+
+void JsonSkipSpace(JsonCursor &c);
+
+// skip whitespace and consume ch if it comes next
+bool JsonConsume(JsonCursor &c, char ch);
+
+bool JsonConsumeLiteral(JsonCursor &c, const char *literal);
+
+// a string token, returned as the bytes between the quotes without unescaping
+bool JsonParseString(JsonCursor &c, const char *&str, size_t &len);
+
+// a number token, rounded exactly like strtod
+bool JsonParseNumber(JsonCursor &c, double &value);
+
+// mantissa * 10^exponent rounded to the nearest double, like strtod. false if
+// the fast paths can't decide the rounding, the caller then has to use strtod.
+bool JsonDecimalToDouble(uint64_t mantissa, int exponent, double &value);
+
+// longest text JsonWriteNumber writes
+static const int kJsonMaxNumberLength = 32;
+
+// the shortest decimal text that reads back as exactly value, "null" if value
+// is not finite like json.hpp does. out needs kJsonMaxNumberLength bytes, no
+// terminating zero is written. returns the length.
+int JsonWriteNumber(double value, char *out);
+
+template <class Handler>
+bool JsonSaxValue(JsonCursor &c, Handler &handler, int depth)
+{
+  JsonSkipSpace(c);
+  if(c.p >= c.end || depth > kJsonMaxDepth)
+  {
+    return false;
+  }
+
+  const char *str;
+  size_t len;
+  double number;
+
+  switch(*c.p)
+  {
+  case '"':
+    return JsonParseString(c, str, len) && handler.String(str, len);
+
+  case '[':
+    c.p++;
+    if(!handler.StartArray())
+    {
+      return false;
+    }
+    if(!JsonConsume(c, ']'))
+    {
+      do
+      {
+        if(!JsonSaxValue(c, handler, depth + 1))
+        {
+          return false;
+        }
+      } while(JsonConsume(c, ','));
+      if(!JsonConsume(c, ']'))
+      {
+        return false;
+      }
+    }
+    return handler.EndArray();
+
+  case '{':
+    c.p++;
+    if(!handler.StartObject())
+    {
+      return false;
+    }
+    if(!JsonConsume(c, '}'))
+    {
+      do
+      {
+        if(!JsonParseString(c, str, len) || !handler.Key(str, len) ||
+           !JsonConsume(c, ':') || !JsonSaxValue(c, handler, depth + 1))
+        {
+          return false;
+        }
+      } while(JsonConsume(c, ','));
+      if(!JsonConsume(c, '}'))
+      {
+        return false;
+      }
+    }
+    return handler.EndObject();
+
+  case 't':
+    return JsonConsumeLiteral(c, "true") && handler.Boolean(true);
+
+  case 'f':
+    return JsonConsumeLiteral(c, "false") && handler.Boolean(false);
+
+  case 'n':
+    return JsonConsumeLiteral(c, "null") && handler.Null();
+
+  default:
+    return JsonParseNumber(c, number) && handler.Number(number);
+  }
+}
+
+// parse one json value from the length bytes at data and report it to the handler.
+// false if the text is malformed, has trailing data or the handler stopped.
+template <class Handler>
+bool JsonSaxParse(const char *data, size_t length, Handler &handler)
+{
+  JsonCursor c = {data, data + length};
+
+  if(!JsonSaxValue(c, handler, 0))
+  {
+    return false;
+  }
+  JsonSkipSpace(c);
+
+  return c.p == c.end;
+}
+
+#endif // JSON_SAX_H
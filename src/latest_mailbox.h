@@ -0,0 +1,83 @@
+#ifndef LATEST_MAILBOX_H
+#define LATEST_MAILBOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// lock-free single-slot mailbox between one producer and one consumer thread
+// that only ever hands over the newest value. a triple buffer: the producer
+// fills its own slot and publishes it by swapping it with the middle slot,
+// the consumer takes the middle slot by swapping it with its own, so neither
+// side waits and a slot is never read while written. a value that is
+// published over one the consumer hasn't taken yet replaces it and counts as
+// dropped.
+//
+// the values are assigned in place, a T that keeps its buffers (a string, a
+// vector) doesn't allocate once the three slots are grown.
+template <class T>
+class LatestMailbox
+{
+public:
+  LatestMailbox() : write_(0), read_(1), middle_(2), dropped_(0) {}
+
+  // producer: the slot to fill, then publish it
+  T &writing() { return slots_[write_]; }
+
+  // producer: make the filled slot the newest value. true if that dropped an
+  // older value the consumer never took.
+  bool Publish()
+  {
+    uint8_t old = middle_.exchange(write_ | kFresh, std::memory_order_acq_rel);
+    write_ = old & kIndexMask;
+    if(old & kFresh)
+    {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    return false;
+  }
+
+  // whether a value was published since the consumer last took one
+  bool fresh() const { return (middle_.load(std::memory_order_acquire) & kFresh) != 0; }
+
+  // consumer: the newest value, NULL if there is none since the last call.
+  // it stays valid and unchanged until the next call.
+  T *Take()
+  {
+    // only the producer sets the flag and only here it's cleared, so it's
+    // still set when the exchange below happens
+    if(!fresh())
+    {
+      return NULL;
+    }
+    uint8_t old = middle_.exchange(read_, std::memory_order_acq_rel);
+    read_ = old & kIndexMask;
+    return &slots_[read_];
+  }
+
+  // values overwritten before the consumer took them
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  LatestMailbox(const LatestMailbox &);
+  LatestMailbox &operator=(const LatestMailbox &);
+
+  static const uint8_t kIndexMask = 3;
+  static const uint8_t kFresh = 4;
+
+  T slots_[3];
+
+  // slot indices, write_ only touched by the producer and read_ by the consumer.
+  // padded to cache lines of their own, alignas would need C++17's aligned new.
+  uint8_t write_;
+  char write_pad_[64];
+  uint8_t read_;
+  char read_pad_[64];
+  // index of the middle slot, with kFresh when it holds a value not taken yet
+  std::atomic<uint8_t> middle_;
+
+  std::atomic<uint64_t> dropped_;
+};
+
+#endif // LATEST_MAILBOX_H
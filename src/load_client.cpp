@@ -0,0 +1,721 @@
+// localhost stand-in for the simulator, to load test path_planning. every
+// session is one websocket connection to the server that sends synthetic
+// 42["telemetry",{...}] frames of an ego car and a configurable amount of
+// traffic, and drives the ego car along the next_x/next_y path it gets back,
+// like the simulator does. reports round-trip latency percentiles, the reply
+// rate and from it the sessions one server core sustains.
+//
+// usage: load_client [--sessions N] [--cars N] [--rate HZ] [--duration S] [--threads N]
+//                    [--server-cores N] [--flood] [--binary] [--delta] [--port P]
+//
+// --cars is the number of other cars on the track in every session, the
+// simulator has a dozen. every session sends --rate frames a second, the ego
+// car moving 1/(rate*0.02) path points per frame. a frame that is due while
+// the reply to the last one is still out is counted as late and skipped.
+// --flood sends the next frame as soon as the reply is in instead, which
+// measures how many frames a second the server can answer; sessions per core
+// are that rate over --rate, divided by the --server-cores the server runs on.
+// the sessions are spread over --threads client threads, each with its own
+// event loop, so the client is not what limits the server. --binary speaks
+// the fixed-layout frames of binary_frame.h instead of socket.io text, and
+// --delta asks for delta control frames and puts the path back together from
+// the previous path of the frame they answer.
+//
+// every reply is also checked against the simulator's 10 m/s^2 acceleration
+// limit. the planner keeps the speed of every connection apart, a server that
+// mixes up the state of its sessions changes speed in jumps and fails this,
+// so a run with hundreds of --sessions checks that they don't share any.
+// the client exits with 1 if a reply doesn't decode, a session fails to
+// connect or is dropped, or more than kMaxHarshFraction of the replies exceed
+// the limit.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+#include <uWS/uWS.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frenet.h"
+#include "frenet_tracker.h"
+#include "highway_map.h"
+#include "control_message.h"
+#include "json_sax.h"
+#include "telemetry.h"
+#include "tool_common.h"
+
+using namespace std;
+
+// the server only ever listens on the loopback interface for this tool
+static const char kHost[] = "ws://127.0.0.1";
+
+// seconds between two points of the path, the simulator's step
+static const double kPointDt = 0.02;
+
+// meters per second in a mile per hour, the simulator reports speed in mph
+static const double kMphToMps = 0.44704;
+
+// the most a path may speed up or slow down along the way, the simulator's limit
+static const double kMaxAcceleration = 10;
+
+// replies over kMaxAcceleration a run may have. braking hard behind traffic
+// makes a few, 50 sessions that shared one planner made 7% of them.
+static const double kMaxHarshFraction = 0.01;
+
+// FrenetTracker id of the end of the previous path, next to kEgoId
+static const int kPathEndId = -2;
+
+struct Options
+{
+  int sessions;
+  int cars;
+  double rate;
+  double duration;
+  int threads;
+  int server_cores;
+  bool flood;
+  bool binary;
+  bool delta;
+  int port;
+};
+
+// one car of the synthetic traffic, moving along its lane at constant speed
+struct TrafficCar
+{
+  double s;
+  double d;
+  double speed;         // m/s
+};
+
+// JsonSaxParse handler that takes next_x and next_y out of a control frame,
+// and ack_seq and base out of a delta
+class ControlSax
+{
+public:
+  ControlSax(vector<double> &next_x, vector<double> &next_y)
+    : delta(false), base(0), ack_seq(0), next_x_(next_x), next_y_(next_y), depth_(0), values_(NULL), number_(NULL)
+  {
+    next_x_.clear();
+    next_y_.clear();
+  }
+
+  bool delta;
+  double base;
+  double ack_seq;
+
+  bool Null() { return true; }
+  bool Boolean(bool) { return true; }
+  bool String(const char *, size_t) { return true; }
+  bool StartObject() { depth_++; return true; }
+  bool EndObject() { depth_--; return true; }
+  bool StartArray() { depth_++; return true; }
+  bool EndArray() { depth_--; return true; }
+
+  bool Number(double value)
+  {
+    if (depth_ == 3 && values_ != NULL) {
+      values_->push_back(value);
+    } else if (depth_ == 2 && number_ != NULL) {
+      *number_ = value;
+    }
+    return true;
+  }
+
+  bool Key(const char *str, size_t len)
+  {
+    if (depth_ == 2) {
+      values_ = NULL;
+      number_ = NULL;
+      if (len == 6 && memcmp(str, "next_x", 6) == 0) values_ = &next_x_;
+      else if (len == 6 && memcmp(str, "next_y", 6) == 0) values_ = &next_y_;
+      else if (len == 4 && memcmp(str, "base", 4) == 0) number_ = &base;
+      else if (len == 7 && memcmp(str, "ack_seq", 7) == 0) number_ = &ack_seq;
+      delta = delta || number_ == &ack_seq;
+    }
+    return true;
+  }
+
+private:
+  vector<double> &next_x_;
+  vector<double> &next_y_;
+  int depth_;
+  vector<double> *values_;
+  double *number_;
+};
+
+class Client;
+
+// one simulated ego car and its connection
+struct Session
+{
+  explicit Session(const HighwayMap &map)
+    : connected(false), tracker(map), telemetry(new Telemetry()), waiting(false), seq(0) {}
+
+  Client *client;
+  int index;            // in the sessions of its client
+  uWS::WebSocket<uWS::CLIENT> ws;
+  bool connected;
+
+  FrenetTracker tracker;
+
+  // ego state as the simulator reports it
+  double x, y, s, d, yaw, speed;
+
+  // what is left of the last path the server sent
+  vector<double> path_x;
+  vector<double> path_y;
+
+  vector<TrafficCar> traffic;
+
+  // the next frame, and the telemetry it is written from, both reused
+  unique_ptr<Telemetry> telemetry;
+  string frame;
+
+  // a frame is out and its reply not yet in
+  bool waiting;
+  uint32_t seq;         // of the last frame, for --delta
+  chrono::steady_clock::time_point sent;
+
+  uv_timer_t timer;
+};
+
+// the sessions of one client thread, on their own hub and event loop
+class Client
+{
+public:
+  Client(const HighwayMap &map, const Options &options, int first_session, int num_sessions);
+
+  void Run();
+
+  // results
+  vector<double> rtt_us;
+  long frames_sent;
+  long replies;
+  long bytes_sent;
+  long bytes_received;
+  long late;
+  long errors;
+  long disconnects;
+  long bad_replies;     // replies that don't decode, or deltas that don't fit the frame sent
+  long harsh_replies;   // paths that accelerate faster than kMaxAcceleration
+
+private:
+  void StartSession(Session &session);
+  void Send(Session &session);
+  bool DecodeReply(Session &session, const char *data, size_t length, bool binary);
+  void Advance(Session &session, const vector<double> &next_x, const vector<double> &next_y);
+  void WriteFrame(Session &session);
+  void Stop();
+
+  static void OnTimer(uv_timer_t *timer);
+  static void OnStop(uv_timer_t *timer);
+
+  const HighwayMap &map_;
+  const Options &options_;
+
+  uWS::Hub hub_;
+  vector<unique_ptr<Session> > sessions_;
+
+  // path points the ego car moves on per frame
+  int points_per_frame_;
+
+  uv_timer_t stop_timer_;
+
+  // decoded reply, reused
+  vector<double> next_x_;
+  vector<double> next_y_;
+};
+
+static void AppendNumber(string &out, double value)
+{
+  char number[kJsonMaxNumberLength];
+  out.append(number, JsonWriteNumber(value, number));
+}
+
+// largest change of speed between two steps of a path, in m/s^2
+static double MaxAcceleration(const vector<double> &x, const vector<double> &y)
+{
+  double max_acceleration = 0;
+  for (size_t i = 2; i < x.size(); i++) {
+    double v0 = distance(x[i-2], y[i-2], x[i-1], y[i-1]) / kPointDt;
+    double v1 = distance(x[i-1], y[i-1], x[i], y[i]) / kPointDt;
+    max_acceleration = max(max_acceleration, fabs(v1 - v0) / kPointDt);
+  }
+  return max_acceleration;
+}
+
+// the telemetry event as the simulator writes it
+static void WriteTextTelemetry(const Telemetry &telemetry, string &out)
+{
+  out.clear();
+
+  out += "42[\"telemetry\",{\"x\":";
+  AppendNumber(out, telemetry.x);
+  out += ",\"y\":";
+  AppendNumber(out, telemetry.y);
+  out += ",\"yaw\":";
+  AppendNumber(out, telemetry.yaw);
+  out += ",\"speed\":";
+  AppendNumber(out, telemetry.speed);
+  out += ",\"s\":";
+  AppendNumber(out, telemetry.s);
+  out += ",\"d\":";
+  AppendNumber(out, telemetry.d);
+  if (telemetry.delta) {
+    out += ",\"seq\":";
+    out += to_string(telemetry.seq);
+  }
+
+  out += ",\"previous_path_x\":[";
+  for (int i = 0; i < telemetry.prev_size; i++) {
+    if (i) out += ',';
+    AppendNumber(out, telemetry.previous_path_x[i]);
+  }
+  out += "],\"previous_path_y\":[";
+  for (int i = 0; i < telemetry.prev_size; i++) {
+    if (i) out += ',';
+    AppendNumber(out, telemetry.previous_path_y[i]);
+  }
+  out += "],\"end_path_s\":";
+  AppendNumber(out, telemetry.end_path_s);
+  out += ",\"end_path_d\":";
+  AppendNumber(out, telemetry.end_path_d);
+
+  // [id, x, y, vx, vy, s, d] of every other car
+  out += ",\"sensor_fusion\":[";
+  for (int i = 0; i < telemetry.num_cars; i++) {
+    const SensorFusionRow &row = telemetry.sensor_fusion[i];
+    out += i ? ",[" : "[";
+    out += to_string((int)row.id);
+    const double values[] = {row.x, row.y, row.vx, row.vy, row.s, row.d};
+    for (double value : values) {
+      out += ',';
+      AppendNumber(out, value);
+    }
+    out += ']';
+  }
+  out += "]}]";
+}
+
+Client::Client(const HighwayMap &map, const Options &options, int first_session, int num_sessions)
+  : frames_sent(0), replies(0), bytes_sent(0), bytes_received(0), late(0), errors(0), disconnects(0), bad_replies(0),
+    harsh_replies(0), map_(map), options_(options)
+{
+  points_per_frame_ = max(1, (int)lround(1.0 / (options_.rate * kPointDt)));
+
+  mt19937 rng(first_session + 1);
+  uniform_real_distribution<double> track_s(0, map_.max_s());
+  uniform_int_distribution<int> lane(0, 2);
+  uniform_real_distribution<double> traffic_speed(15, 22);
+
+  for (int i = 0; i < num_sessions; i++) {
+    Session *session = new Session(map_);
+    session->client = this;
+    session->index = i;
+
+    // ego cars are spread over the track, standing in the middle lane
+    session->s = map_.max_s() * (first_session + i) / options_.sessions;
+    session->d = 6;
+    map_.getXY(session->s, session->d, session->x, session->y);
+    // heading of the road center, the lane offset jumps where the waypoint segments meet
+    double center_x, center_y, ahead_x, ahead_y;
+    map_.getXY(session->s, 0, center_x, center_y);
+    map_.getXY(session->s + 1, 0, ahead_x, ahead_y);
+    session->yaw = atan2(ahead_y - center_y, ahead_x - center_x) * 180 / pi();
+    session->speed = 0;
+
+    for (int k = 0; k < options_.cars; k++) {
+      TrafficCar car;
+      car.s = track_s(rng);
+      car.d = 2 + 4 * lane(rng);
+      car.speed = traffic_speed(rng);
+      session->traffic.push_back(car);
+    }
+
+    sessions_.push_back(unique_ptr<Session>(session));
+  }
+}
+
+void Client::Run()
+{
+  hub_.onConnection([this](uWS::WebSocket<uWS::CLIENT> ws, uWS::HttpRequest) {
+    Session &session = *(Session *)ws.getUserData();
+    session.ws = ws;
+    session.connected = true;
+    StartSession(session);
+  });
+
+  hub_.onMessage([this](uWS::WebSocket<uWS::CLIENT> ws, char *data, size_t length, uWS::OpCode opCode) {
+    Session &session = *(Session *)ws.getUserData();
+    if (!session.waiting) {
+      return;
+    }
+    session.waiting = false;
+    rtt_us.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - session.sent).count());
+    replies++;
+    bytes_received += length;
+
+    if (DecodeReply(session, data, length, opCode == uWS::OpCode::BINARY)) {
+      if (MaxAcceleration(next_x_, next_y_) > kMaxAcceleration) {
+        harsh_replies++;
+      }
+      Advance(session, next_x_, next_y_);
+    } else {
+      bad_replies++;
+    }
+
+    if (options_.flood) {
+      Send(session);
+    }
+  });
+
+  hub_.onError([this](void *) {
+    errors++;
+  });
+
+  hub_.onDisconnection([this](uWS::WebSocket<uWS::CLIENT> ws, int, char *, size_t) {
+    Session &session = *(Session *)ws.getUserData();
+    if (session.connected) {
+      session.connected = false;
+      uv_timer_stop(&session.timer);
+      disconnects++;
+    }
+  });
+
+  uv_timer_init(hub_.getLoop(), &stop_timer_);
+  stop_timer_.data = this;
+  uv_timer_start(&stop_timer_, OnStop, (uint64_t)(options_.duration * 1000), 0);
+
+  string url = string(kHost) + ":" + to_string(options_.port);
+  for (auto &session : sessions_) {
+    uv_timer_init(hub_.getLoop(), &session->timer);
+    session->timer.data = session.get();
+    hub_.connect(url, session.get());
+  }
+
+  hub_.run();
+}
+
+void Client::StartSession(Session &session)
+{
+  if (options_.flood) {
+    Send(session);
+    return;
+  }
+
+  // the sessions of a thread send in turns across the period, not all at once
+  uint64_t period_ms = max(1, (int)lround(1000 / options_.rate));
+  uint64_t offset_ms = session.index * period_ms / sessions_.size();
+  uv_timer_start(&session.timer, OnTimer, offset_ms, period_ms);
+}
+
+void Client::OnTimer(uv_timer_t *timer)
+{
+  Session &session = *(Session *)timer->data;
+  if (session.waiting) {
+    session.client->late++;
+    return;
+  }
+  session.client->Send(session);
+}
+
+void Client::OnStop(uv_timer_t *timer)
+{
+  ((Client *)timer->data)->Stop();
+}
+
+void Client::Stop()
+{
+  for (auto &session : sessions_) {
+    uv_timer_stop(&session->timer);
+    if (session->connected) {
+      session->connected = false;
+      session->ws.close();
+    }
+  }
+  uv_stop(hub_.getLoop());
+}
+
+void Client::Send(Session &session)
+{
+  WriteFrame(session);
+  session.waiting = true;
+  session.sent = chrono::steady_clock::now();
+  uWS::OpCode opcode = options_.binary ? uWS::OpCode::BINARY : uWS::OpCode::TEXT;
+  session.ws.send(session.frame.data(), session.frame.size(), opcode);
+  frames_sent++;
+  bytes_sent += session.frame.size();
+}
+
+// the whole next path of a reply into next_x_ and next_y_. a delta goes on
+// from the first base points of the previous path in the frame it answers.
+bool Client::DecodeReply(Session &session, const char *data, size_t length, bool binary)
+{
+  bool delta;
+  uint32_t base, ack_seq;
+  if (binary) {
+    if (!DecodeBinaryControl(data, length, next_x_, next_y_, delta, base, ack_seq)) {
+      return false;
+    }
+  } else {
+    ControlSax handler(next_x_, next_y_);
+    if (length <= 2 || !JsonSaxParse(data + 2, length - 2, handler) || next_x_.size() != next_y_.size()) {
+      return false;
+    }
+    delta = handler.delta;
+    base = (uint32_t)handler.base;
+    ack_seq = (uint32_t)handler.ack_seq;
+  }
+
+  if (!delta) {
+    return !options_.delta;
+  }
+
+  const Telemetry &sent = *session.telemetry;
+  if (!options_.delta || ack_seq != sent.seq || base > (uint32_t)sent.prev_size) {
+    return false;
+  }
+  next_x_.insert(next_x_.begin(), sent.previous_path_x, sent.previous_path_x + base);
+  next_y_.insert(next_y_.begin(), sent.previous_path_y, sent.previous_path_y + base);
+
+  return true;
+}
+
+// the simulator drives the car points_per_frame_ points down the path, and
+// the traffic the same time further along its lanes
+void Client::Advance(Session &session, const vector<double> &next_x, const vector<double> &next_y)
+{
+  int consumed = min(points_per_frame_, (int)next_x.size());
+  if (consumed > 0) {
+    double last_x = session.x;
+    double last_y = session.y;
+    if (consumed >= 2) {
+      last_x = next_x[consumed-2];
+      last_y = next_y[consumed-2];
+    }
+    session.x = next_x[consumed-1];
+    session.y = next_y[consumed-1];
+
+    double dist = distance(last_x, last_y, session.x, session.y);
+    session.speed = dist / kPointDt / kMphToMps;
+    if (dist > 1e-6) {
+      session.yaw = atan2(session.y - last_y, session.x - last_x) * 180 / pi();
+    }
+    session.tracker.getFrenet(FrenetTracker::kEgoId, session.x, session.y, session.yaw * pi() / 180,
+                              session.s, session.d);
+  }
+
+  session.path_x.assign(next_x.begin() + consumed, next_x.end());
+  session.path_y.assign(next_y.begin() + consumed, next_y.end());
+
+  double dt = points_per_frame_ * kPointDt;
+  for (TrafficCar &car : session.traffic) {
+    car.s = WrapS(car.s + car.speed * dt, map_.max_s());
+  }
+}
+
+void Client::WriteFrame(Session &session)
+{
+  Telemetry &telemetry = *session.telemetry;
+
+  telemetry.x = session.x;
+  telemetry.y = session.y;
+  telemetry.s = session.s;
+  telemetry.d = session.d;
+  telemetry.yaw = session.yaw;
+  telemetry.speed = session.speed;
+  telemetry.delta = options_.delta;
+  telemetry.seq = ++session.seq;
+
+  telemetry.prev_size = min(session.path_x.size(), (size_t)kMaxPathPoints);
+  copy(session.path_x.begin(), session.path_x.begin() + telemetry.prev_size, telemetry.previous_path_x);
+  copy(session.path_y.begin(), session.path_y.begin() + telemetry.prev_size, telemetry.previous_path_y);
+
+  // like the simulator, the end of an empty path is reported as 0
+  telemetry.end_path_s = 0;
+  telemetry.end_path_d = 0;
+  int n = telemetry.prev_size;
+  if (n >= 2) {
+    const double *path_x = telemetry.previous_path_x;
+    const double *path_y = telemetry.previous_path_y;
+    // a path planned at standstill ends in the same point twice, it has the car's heading
+    double theta = session.yaw * pi() / 180;
+    if (path_x[n-1] != path_x[n-2] || path_y[n-1] != path_y[n-2]) {
+      theta = atan2(path_y[n-1] - path_y[n-2], path_x[n-1] - path_x[n-2]);
+    }
+    session.tracker.getFrenet(kPathEndId, path_x[n-1], path_y[n-1], theta, telemetry.end_path_s, telemetry.end_path_d);
+  }
+
+  telemetry.num_cars = session.traffic.size();
+  for (int i = 0; i < telemetry.num_cars; i++) {
+    const TrafficCar &car = session.traffic[i];
+    SensorFusionRow &row = telemetry.sensor_fusion[i];
+    double ahead_x, ahead_y;
+    session.tracker.getXY(i, car.s, car.d, row.x, row.y);
+    map_.getXY(car.s + 1, car.d, ahead_x, ahead_y);
+    double heading = atan2(ahead_y - row.y, ahead_x - row.x);
+
+    row.id = i;
+    row.vx = car.speed * cos(heading);
+    row.vy = car.speed * sin(heading);
+    row.s = car.s;
+    row.d = car.d;
+  }
+
+  string &out = session.frame;
+  if (options_.binary) {
+    out.resize(BinaryTelemetrySize(telemetry));
+    EncodeBinaryTelemetry(telemetry, &out[0]);
+  } else {
+    WriteTextTelemetry(telemetry, out);
+  }
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  options.sessions = 1;
+  options.cars = 12;
+  options.rate = 25;
+  options.duration = 10;
+  options.threads = 1;
+  options.server_cores = 1;
+  options.flood = false;
+  options.binary = false;
+  options.delta = false;
+  options.port = 4567;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = (i + 1 < argc);
+    if (strcmp(argv[i], "--flood") == 0) {
+      options.flood = true;
+    } else if (strcmp(argv[i], "--binary") == 0) {
+      options.binary = true;
+    } else if (strcmp(argv[i], "--delta") == 0) {
+      options.delta = true;
+    } else if (strcmp(argv[i], "--sessions") == 0 && has_value) {
+      options.sessions = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--cars") == 0 && has_value) {
+      options.cars = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--rate") == 0 && has_value) {
+      options.rate = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--duration") == 0 && has_value) {
+      options.duration = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--threads") == 0 && has_value) {
+      options.threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--server-cores") == 0 && has_value) {
+      options.server_cores = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--port") == 0 && has_value) {
+      options.port = atoi(argv[++i]);
+    } else {
+      std::cerr << "usage: load_client [--sessions N] [--cars N] [--rate HZ] [--duration S] [--threads N]" << std::endl;
+      std::cerr << "                   [--server-cores N] [--flood] [--binary] [--delta] [--port P]" << std::endl;
+      return 1;
+    }
+  }
+  options.threads = max(1, min(options.threads, options.sessions));
+  options.server_cores = max(1, options.server_cores);
+  if (options.sessions < 1 || options.cars < 0 || options.cars > 512 || options.rate <= 0) {
+    std::cerr << "need at least one session, at most 512 cars and a positive rate" << std::endl;
+    return 1;
+  }
+
+  HighwayMap map;
+  string map_error;
+  if (!map.Open(kMapBinFile, map_error)) {
+    MapWaypoints map_waypoints;
+    if (!LoadMapCsv(kMapCsvFile, map_waypoints)) {
+      std::cerr << "Failed to load map from " << kMapBinFile << " or " << kMapCsvFile << std::endl;
+      return 1;
+    }
+    map.Build(map_waypoints, kMapMaxS);
+  }
+
+  vector<unique_ptr<Client> > clients;
+  for (int t = 0; t < options.threads; t++) {
+    int first = options.sessions * t / options.threads;
+    int last = options.sessions * (t + 1) / options.threads;
+    clients.push_back(unique_ptr<Client>(new Client(map, options, first, last - first)));
+  }
+
+  auto start = chrono::steady_clock::now();
+
+  vector<thread> threads;
+  for (auto &client : clients) {
+    Client *c = client.get();
+    threads.push_back(thread([c]() { c->Run(); }));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  double wall_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  vector<double> rtt_us;
+  long frames_sent = 0, replies = 0, bytes_sent = 0, bytes_received = 0, late = 0, errors = 0, disconnects = 0;
+  long bad_replies = 0, harsh_replies = 0;
+  for (auto &client : clients) {
+    rtt_us.insert(rtt_us.end(), client->rtt_us.begin(), client->rtt_us.end());
+    frames_sent += client->frames_sent;
+    replies += client->replies;
+    bytes_sent += client->bytes_sent;
+    bytes_received += client->bytes_received;
+    late += client->late;
+    errors += client->errors;
+    disconnects += client->disconnects;
+    bad_replies += client->bad_replies;
+    harsh_replies += client->harsh_replies;
+  }
+  sort(rtt_us.begin(), rtt_us.end());
+
+  double reply_rate = replies / wall_s;
+
+  std::cout << options.sessions << " sessions, " << options.cars << " cars each, ";
+  std::cout << (options.flood ? string("flood") : to_string(options.rate) + " Hz") << ", ";
+  std::cout << (options.binary ? "binary" : "text") << (options.delta ? " delta" : "") << " frames, ";
+  std::cout << options.threads << " client threads, " << wall_s << " s" << std::endl;
+  std::cout << "frames " << frames_sent << ", replies " << replies << " (" << reply_rate << "/s), late " << late;
+  std::cout << ", bad replies " << bad_replies << ", connect errors " << errors << ", disconnects " << disconnects;
+  std::cout << std::endl;
+  // a few come from braking hard behind traffic, sessions that share state make most of them
+  printf("replies over %.0f m/s^2: %ld (%.2f%%)\n", kMaxAcceleration, harsh_replies,
+         replies > 0 ? 100.0 * harsh_replies / replies : 0.0);
+  if (frames_sent > 0 && replies > 0) {
+    std::cout << "bytes per frame " << bytes_sent / frames_sent << " sent, ";
+    std::cout << bytes_received / replies << " received" << std::endl;
+  }
+  printf("rtt us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", Percentile(rtt_us, 50),
+         Percentile(rtt_us, 90), Percentile(rtt_us, 99), Percentile(rtt_us, 99.9), rtt_us.empty() ? 0.0 : rtt_us.back());
+
+  if (options.flood) {
+    // every session needs rate replies a second
+    std::cout << "sustainable sessions per server core at " << options.rate << " Hz: ";
+    std::cout << (long)(reply_rate / options.rate / options.server_cores) << std::endl;
+  } else {
+    // a session keeps up if its replies arrive within the frame period
+    double on_time = frames_sent + late > 0 ? 100.0 * frames_sent / (frames_sent + late) : 0;
+    bool sustained = Percentile(rtt_us, 99) < 1e6 / options.rate && on_time >= 99 && errors == 0;
+    printf("frames on time %.2f%%, %s\n", on_time, sustained ? "sustained" : "not sustained");
+  }
+
+  if (bad_replies > 0 || errors > 0 || disconnects > 0) {
+    std::cout << "FAILED: bad replies, connect errors or disconnects" << std::endl;
+    return 1;
+  }
+  if (replies == 0 || harsh_replies > kMaxHarshFraction * replies) {
+    printf("FAILED: no replies, or more than %.0f%% of them over %.0f m/s^2\n", 100 * kMaxHarshFraction,
+           kMaxAcceleration);
+    return 1;
+  }
+
+  return 0;
+}
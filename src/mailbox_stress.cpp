@@ -0,0 +1,168 @@
+// stress test of LatestMailbox, the single-slot mailbox that hands frames
+// from the event loops to the workers. one producer thread publishes numbered
+// values as fast as it can while a consumer thread takes them, and checks
+// that
+//  - the values it takes are strictly increasing, the mailbox never hands
+//    back an older value than one already taken,
+//  - no value is torn: every field and the whole buffer of a value carry its
+//    number, so a slot read while written shows up,
+//  - taken + dropped == published, nothing is lost without being counted,
+//  - the last value published is the last one taken.
+// the rounds pace the consumer, the producer, both or neither, to get drops,
+// an empty mailbox and everything in between.
+//
+// usage: mailbox_stress [values]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "latest_mailbox.h"
+
+using namespace std;
+
+// a value like PendingFrame, with a buffer that is reused between values
+struct Value
+{
+  uint64_t seq;
+  uint64_t check;
+  vector<uint64_t> buffer;
+};
+
+// pace one side of the mailbox: spin a little and let the other thread run,
+// turns times. without the yields, two threads on one core only take turns
+// when their time slices end.
+static void Pace(int turns)
+{
+  for (int turn = 0; turn < turns; turn++) {
+    for (volatile int i = 0; i < 100; i++) {
+    }
+    this_thread::yield();
+  }
+}
+
+struct Round
+{
+  const char *name;
+  // turns given to the other thread after every value
+  int producer_pace;
+  int consumer_pace;
+};
+
+// publish values 1..count through a fresh mailbox, false if a check failed
+static bool RunRound(const Round &round, uint64_t count)
+{
+  LatestMailbox<Value> mailbox;
+  atomic<bool> done(false);
+
+  uint64_t taken = 0;
+  uint64_t last = 0;
+  uint64_t out_of_order = 0;
+  uint64_t torn = 0;
+
+  auto start = chrono::steady_clock::now();
+
+  thread consumer([&]() {
+    for (;;) {
+      // read before taking, a value published before done is still taken
+      bool finished = done.load(memory_order_acquire);
+      Value *value = mailbox.Take();
+      if (value == NULL) {
+        if (finished) {
+          break;
+        }
+        // nothing to take, let the producer run
+        this_thread::yield();
+        continue;
+      }
+
+      taken++;
+      uint64_t seq = value->seq;
+      if (seq <= last) {
+        out_of_order++;
+      }
+      last = seq;
+
+      // hold the value while the producer runs, a slot the producer writes
+      // to before it's handed back shows in the rest of the value
+      Pace(round.consumer_pace);
+
+      bool whole = (value->seq == seq) && (value->check == ~seq) && (value->buffer.size() == 1 + seq % 16);
+      for (size_t i = 0; whole && i < value->buffer.size(); i++) {
+        whole = (value->buffer[i] == seq);
+      }
+      if (!whole) {
+        torn++;
+      }
+    }
+  });
+
+  for (uint64_t seq = 1; seq <= count; seq++) {
+    Value &value = mailbox.writing();
+    value.seq = seq;
+    value.buffer.assign(1 + seq % 16, seq);
+    value.check = ~seq;
+    mailbox.Publish();
+
+    Pace(round.producer_pace);
+  }
+  done.store(true, memory_order_release);
+  consumer.join();
+
+  double wall_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  uint64_t dropped = mailbox.dropped();
+
+  printf("%-16s published %llu, taken %llu, dropped %llu, in %.3f s\n", round.name, (unsigned long long)count,
+         (unsigned long long)taken, (unsigned long long)dropped, wall_s);
+
+  bool ok = true;
+  if (out_of_order > 0) {
+    printf("FAILED: %llu value(s) taken after a newer one\n", (unsigned long long)out_of_order);
+    ok = false;
+  }
+  if (torn > 0) {
+    printf("FAILED: %llu torn value(s)\n", (unsigned long long)torn);
+    ok = false;
+  }
+  if (taken + dropped != count) {
+    printf("FAILED: taken + dropped is %llu, not the %llu published\n", (unsigned long long)(taken + dropped),
+           (unsigned long long)count);
+    ok = false;
+  }
+  if (last != count) {
+    printf("FAILED: the last value taken is %llu, not the last published %llu\n", (unsigned long long)last,
+           (unsigned long long)count);
+    ok = false;
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  uint64_t count = 1000000;
+  if (argc > 1) {
+    count = strtoull(argv[1], NULL, 10);
+  }
+  if (argc > 2 || count < 1) {
+    fprintf(stderr, "usage: mailbox_stress [values]\n");
+    return 1;
+  }
+
+  const Round rounds[] = {
+    {"slow consumer", 1, 4},
+    {"slow producer", 4, 0},
+    {"both paced", 1, 1},
+    {"unpaced", 0, 0},
+  };
+
+  bool ok = true;
+  for (const Round &round : rounds) {
+    ok = RunRound(round, count) && ok;
+  }
+  printf(ok ? "ok\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
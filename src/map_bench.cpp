@@ -0,0 +1,759 @@
+// benchmark of the map queries against the linear scans the planner used
+// before, on the track of data/highway_map.csv resampled to a growing number
+// of waypoints: the closest waypoint from the k-d tree against scanning every
+// waypoint, and getFrenet's s from the cumulative arc length table against
+// summing the segments up to the car on every call, and the segment getXY
+// finds by binary search against walking the waypoints from the first one,
+// and HighwayMap's getXY from the per-segment tangent table against the
+// atan2/cos/sin of frenet.cpp's, and the planner's 0.5 m reference line
+// against the same trig, with the line's memory and build time, and
+// FrenetTracker's lookups from the last waypoint of a car against the global
+// search, on cars driven along the track. the batch conversions, HighwayMap's
+// getFrenetBatch and ReferenceLine's getXYBatch, are checked against and timed
+// next to their scalar versions. every table checks that both sides agree
+// before it times them. reports time per query.
+//
+// usage: map_bench [queries]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "frenet.h"
+#include "frenet_tracker.h"
+#include "highway_map.h"
+#include "map_file.h"
+#include "reference_line.h"
+#include "tool_common.h"
+
+using namespace std;
+
+// the previous closest waypoint search, kept here as the baseline
+static int ClosestWaypointLinear(double x, double y, const vector<double> &maps_x, const vector<double> &maps_y)
+{
+  double closestLen = 100000; //large number
+  int closestWaypoint = 0;
+
+  for (size_t i = 0; i < maps_x.size(); i++) {
+    double dist = distance(x, y, maps_x[i], maps_y[i]);
+    if (dist < closestLen) {
+      closestLen = dist;
+      closestWaypoint = i;
+    }
+  }
+
+  return closestWaypoint;
+}
+
+// the previous getFrenet, kept here as the baseline. it summed the segment
+// lengths up to the car for s on every call.
+static vector<double> getFrenetSummed(double x, double y, double theta, const vector<double> &maps_x,
+                                      const vector<double> &maps_y)
+{
+  int next_wp = NextWaypoint(ClosestWaypointLinear(x, y, maps_x, maps_y), x, y, theta, maps_x, maps_y);
+
+  int prev_wp;
+  prev_wp = next_wp-1;
+  if (next_wp == 0) {
+    prev_wp = maps_x.size()-1;
+  }
+
+  double n_x = maps_x[next_wp]-maps_x[prev_wp];
+  double n_y = maps_y[next_wp]-maps_y[prev_wp];
+  double x_x = x - maps_x[prev_wp];
+  double x_y = y - maps_y[prev_wp];
+
+  // find the projection of x onto n
+  double proj_norm = (x_x*n_x+x_y*n_y)/(n_x*n_x+n_y*n_y);
+  double proj_x = proj_norm*n_x;
+  double proj_y = proj_norm*n_y;
+
+  double frenet_d = distance(x_x, x_y, proj_x, proj_y);
+
+  //see if d value is positive or negative by comparing it to a center point
+  double center_x = 1000-maps_x[prev_wp];
+  double center_y = 2000-maps_y[prev_wp];
+  double centerToPos = distance(center_x, center_y, x_x, x_y);
+  double centerToRef = distance(center_x, center_y, proj_x, proj_y);
+
+  if (centerToPos <= centerToRef) {
+    frenet_d *= -1;
+  }
+
+  // calculate s value
+  double frenet_s = 0;
+  for (int i = 0; i < prev_wp; i++) {
+    frenet_s += distance(maps_x[i], maps_y[i], maps_x[i+1], maps_y[i+1]);
+  }
+
+  frenet_s += distance(0, 0, proj_x, proj_y);
+
+  return {frenet_s, frenet_d};
+}
+
+// the previous getXY, kept here as the baseline. it walked the waypoints from
+// the first one up to s. the walk checks the bounds before reading the next
+// waypoint now, it read one past the end for s beyond the last waypoint.
+static vector<double> getXYLinear(double s, double d, const vector<double> &maps_s, const vector<double> &maps_x,
+                                  const vector<double> &maps_y)
+{
+  int prev_wp = -1;
+
+  while ((prev_wp < (int)(maps_s.size()-1)) && s > maps_s[prev_wp+1]) {
+    prev_wp++;
+  }
+
+  int wp2 = (prev_wp+1)%maps_x.size();
+
+  double heading = atan2((maps_y[wp2]-maps_y[prev_wp]), (maps_x[wp2]-maps_x[prev_wp]));
+  // the x,y,s along the segment
+  double seg_s = (s-maps_s[prev_wp]);
+
+  double seg_x = maps_x[prev_wp]+seg_s*cos(heading);
+  double seg_y = maps_y[prev_wp]+seg_s*sin(heading);
+
+  double perp_heading = heading-pi()/2;
+
+  double x = seg_x + d*cos(perp_heading);
+  double y = seg_y + d*sin(perp_heading);
+
+  return {x, y};
+}
+
+// the track resampled to n waypoints evenly spaced in s along its center line
+static void ResampleTrack(const HighwayMap &track, int n, MapWaypoints &waypoints)
+{
+  waypoints = MapWaypoints();
+  for (int i = 0; i < n; i++) {
+    double s = track.max_s() * i / n;
+    double x, y;
+    track.getXY(s, 0, x, y);
+    int segment = track.PrevWaypoint(s);
+    waypoints.x.push_back(x);
+    waypoints.y.push_back(y);
+    waypoints.s.push_back(s);
+    waypoints.dx.push_back(track.normal_x()[segment]);
+    waypoints.dy.push_back(track.normal_y()[segment]);
+  }
+}
+
+// positions on the road, anywhere along the track and across its three lanes
+struct Queries
+{
+  vector<double> x;
+  vector<double> y;
+  vector<double> s;
+  vector<double> d;
+  // heading of the road there
+  vector<double> theta;
+};
+
+static void MakeQueries(const HighwayMap &map, int n, mt19937 &rng, Queries &queries)
+{
+  uniform_real_distribution<double> along(0, map.max_s());
+  uniform_real_distribution<double> across(0, 12);
+
+  queries = Queries();
+  for (int i = 0; i < n; i++) {
+    double s = along(rng);
+    double d = across(rng);
+    double x, y;
+    map.getXY(s, d, x, y);
+    queries.x.push_back(x);
+    queries.y.push_back(y);
+    queries.s.push_back(s);
+    queries.d.push_back(d);
+    queries.theta.push_back(map.heading()[map.PrevWaypoint(s)]);
+  }
+}
+
+// one map size of the benchmark
+struct BenchMap
+{
+  MapWaypoints waypoints;
+  HighwayMap map;
+  ReferenceLine line;
+  Queries queries;
+};
+
+static bool BenchClosest(const BenchMap &bench)
+{
+  const MapWaypoints &waypoints = bench.waypoints;
+  const HighwayMap &map = bench.map;
+  const Queries &queries = bench.queries;
+  int n = queries.x.size();
+
+  for (int i = 0; i < n; i++) {
+    if (map.ClosestWaypoint(queries.x[i], queries.y[i]) !=
+        ClosestWaypointLinear(queries.x[i], queries.y[i], waypoints.x, waypoints.y)) {
+      std::cerr << "closest waypoints differ for " << waypoints.x.size() << " waypoints" << std::endl;
+      return false;
+    }
+  }
+
+  long sink = 0;
+
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    sink += ClosestWaypointLinear(queries.x[i], queries.y[i], waypoints.x, waypoints.y);
+  }
+  double linear_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / n;
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    sink += map.ClosestWaypoint(queries.x[i], queries.y[i]);
+  }
+  double tree_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / n;
+
+  printf("%9zu  %15.3f  %16.3f  %7.1fx%s\n", waypoints.x.size(), linear_us, tree_us, linear_us / tree_us,
+         sink == 0 ? " " : "");
+  return true;
+}
+
+// s and d of getFrenet from the cumulative table, in HighwayMap and in
+// frenet.cpp, against the summed s. on every waypoint, in the middle of every
+// segment and just before the end of the closing segment, where s wraps at
+// max_s.
+static bool CheckFrenet(const BenchMap &bench)
+{
+  const vector<double> &maps_x = bench.waypoints.x;
+  const vector<double> &maps_y = bench.waypoints.y;
+  vector<double> maps_cum_s = CumulativeDistance(maps_x, maps_y);
+  const HighwayMap &map = bench.map;
+  int n = map.size();
+
+  const double kTolerance = 1e-9;
+  double max_error = 0;
+  int points = 0;
+
+  for (int i = 0; i < n; i++) {
+    int next = (i + 1) % n;
+    const double fractions[] = {0, 0.5, 0.999};
+    for (double fraction : fractions) {
+      if (fraction == 0.999 && next != 0) {
+        continue;
+      }
+      double x = maps_x[i] + fraction * (maps_x[next] - maps_x[i]);
+      double y = maps_y[i] + fraction * (maps_y[next] - maps_y[i]);
+      double theta = map.heading()[i];
+
+      vector<double> summed = getFrenetSummed(x, y, theta, maps_x, maps_y);
+      vector<double> table = getFrenet(x, y, theta, maps_x, maps_y, maps_cum_s, map.tree());
+      double s, d;
+      map.getFrenet(x, y, theta, s, d);
+
+      double error = max(max(fabs(table[0] - summed[0]), fabs(s - summed[0])),
+                         max(fabs(table[1] - summed[1]), fabs(d - summed[1])));
+      if (!(error <= kTolerance)) {
+        fprintf(stderr, "getFrenet differs from the summed s by %g m at waypoint %d + %g of %d waypoints\n", error,
+                i, fraction, n);
+        return false;
+      }
+      max_error = max(max_error, error);
+      points++;
+    }
+  }
+
+  printf("%9d  %6d  %13g\n", n, points, max_error);
+  return true;
+}
+
+static void BenchFrenet(const BenchMap &bench)
+{
+  const Queries &queries = bench.queries;
+  int n = queries.x.size();
+
+  double sink = 0;
+
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    sink += getFrenetSummed(queries.x[i], queries.y[i], queries.theta[i], bench.waypoints.x, bench.waypoints.y)[0];
+  }
+  double summed_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / n;
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    double s, d;
+    bench.map.getFrenet(queries.x[i], queries.y[i], queries.theta[i], s, d);
+    sink += s;
+  }
+  double table_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / n;
+
+  printf("%9d  %15.3f  %14.3f  %7.1fx%s\n", bench.map.size(), summed_us, table_us, summed_us / table_us,
+         sink == 0 ? " " : "");
+}
+
+// getXY of frenet.cpp, which finds the segment by binary search, against the walk
+static bool BenchXYSearch(const BenchMap &bench)
+{
+  const MapWaypoints &waypoints = bench.waypoints;
+  const Queries &queries = bench.queries;
+  double max_s = bench.map.max_s();
+  int n = queries.x.size();
+
+  // s lies on a waypoint only by chance, there both sides may take a different
+  // segment and agree only within rounding
+  const double kTolerance = 1e-6;
+  for (int i = 0; i < n; i++) {
+    vector<double> walked = getXYLinear(queries.s[i], queries.d[i], waypoints.s, waypoints.x, waypoints.y);
+    vector<double> searched = getXY(queries.s[i], queries.d[i], waypoints.s, waypoints.x, waypoints.y, max_s);
+    if (!(fabs(walked[0] - searched[0]) <= kTolerance && fabs(walked[1] - searched[1]) <= kTolerance)) {
+      std::cerr << "getXY differs from the walk for " << waypoints.x.size() << " waypoints at s " << queries.s[i];
+      std::cerr << std::endl;
+      return false;
+    }
+  }
+
+  double sink = 0;
+
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    sink += getXYLinear(queries.s[i], queries.d[i], waypoints.s, waypoints.x, waypoints.y)[0];
+  }
+  double linear_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / n;
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    sink += getXY(queries.s[i], queries.d[i], waypoints.s, waypoints.x, waypoints.y, max_s)[0];
+  }
+  double binary_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / n;
+
+  printf("%9zu  %15.3f  %15.3f  %7.1fx%s\n", waypoints.x.size(), linear_us, binary_us, linear_us / binary_us,
+         sink == 0 ? " " : "");
+  return true;
+}
+
+// HighwayMap::getXY, which offsets along the stored unit tangent and normal,
+// against frenet.cpp's getXY, which derives them with atan2, cos and sin
+static bool BenchXYTangent(const BenchMap &bench)
+{
+  const MapWaypoints &waypoints = bench.waypoints;
+  const HighwayMap &map = bench.map;
+  const Queries &queries = bench.queries;
+  double max_s = map.max_s();
+  int n = queries.x.size();
+
+  // the trig and the tangent differ only in rounding
+  const double kTolerance = 1e-6;
+  double max_error = 0;
+  for (int i = 0; i < n; i++) {
+    vector<double> trig = getXY(queries.s[i], queries.d[i], waypoints.s, waypoints.x, waypoints.y, max_s);
+    double x, y;
+    map.getXY(queries.s[i], queries.d[i], x, y);
+    double error = max(fabs(x - trig[0]), fabs(y - trig[1]));
+    if (!(error <= kTolerance)) {
+      std::cerr << "tangent getXY differs from the trig one for " << waypoints.x.size() << " waypoints at s ";
+      std::cerr << queries.s[i] << std::endl;
+      return false;
+    }
+    max_error = max(max_error, error);
+  }
+
+  double sink = 0;
+
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    sink += getXY(queries.s[i], queries.d[i], waypoints.s, waypoints.x, waypoints.y, max_s)[0];
+  }
+  double trig_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / n;
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    double x, y;
+    map.getXY(queries.s[i], queries.d[i], x, y);
+    sink += x;
+  }
+  double tangent_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / n;
+
+  printf("%9zu  %13.3f  %16.3f  %7.1fx  %11.2g%s\n", waypoints.x.size(), trig_us, tangent_us, trig_us / tangent_us,
+         max_error, sink == 0 ? " " : "");
+  return true;
+}
+
+// ReferenceLine::getXY, the planner's conversion, against frenet.cpp's getXY.
+// the line interpolates samples of the road center taken every 0.5 m, so on
+// the center line it cuts the corners at the waypoints by a couple of cm.
+// it blends the waypoint normals, where the trig jumps from one segment's
+// normal to the next, so off the center the two differ more, by design; that
+// difference is printed, not checked.
+static bool BenchReferenceLine(const BenchMap &bench)
+{
+  const MapWaypoints &waypoints = bench.waypoints;
+  const HighwayMap &map = bench.map;
+  const Queries &queries = bench.queries;
+  double max_s = map.max_s();
+  int n = queries.x.size();
+
+  auto start = chrono::steady_clock::now();
+  ReferenceLine line;
+  line.Build(map);
+  double build_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+  const double kCenterTolerance = 0.05;
+  double center_error = 0;
+  double max_difference = 0;
+  for (int i = 0; i < n; i++) {
+    double x, y;
+    vector<double> trig = getXY(queries.s[i], 0, waypoints.s, waypoints.x, waypoints.y, max_s);
+    line.getXY(queries.s[i], 0, x, y);
+    center_error = max(center_error, max(fabs(x - trig[0]), fabs(y - trig[1])));
+
+    trig = getXY(queries.s[i], queries.d[i], waypoints.s, waypoints.x, waypoints.y, max_s);
+    line.getXY(queries.s[i], queries.d[i], x, y);
+    max_difference = max(max_difference, max(fabs(x - trig[0]), fabs(y - trig[1])));
+  }
+  if (!(center_error <= kCenterTolerance)) {
+    std::cerr << "the reference line is " << center_error << " m off the road center for " << waypoints.x.size();
+    std::cerr << " waypoints" << std::endl;
+    return false;
+  }
+
+  double sink = 0;
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    sink += getXY(queries.s[i], queries.d[i], waypoints.s, waypoints.x, waypoints.y, max_s)[0];
+  }
+  double trig_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    double x, y;
+    line.getXY(queries.s[i], queries.d[i], x, y);
+    sink += x;
+  }
+  double line_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+
+  printf("%9zu  %7zu  %7zu  %8.2f  %13.1f  %13.1f  %7.1fx  %12.2g  %14.2g%s\n", waypoints.x.size(), line.size(),
+         line.bytes() / 1024, build_ms, trig_ns, line_ns, trig_ns / line_ns, center_error, max_difference,
+         sink == 0 ? " " : "");
+  return true;
+}
+
+// points of the batch conversion check, the timing is per point
+// cars driven along the track for the tracker check, 20 ms frames
+static const int kTrackedCars = 12;
+static const int kTrackedFrames = 1000;
+// every this many frames one car id jumps far ahead, as if it was given to
+// another car, so the hint misses
+static const int kJumpFrames = 100;
+
+// one lookup of the tracker check, a car where the telemetry puts it
+struct TrackedPoint
+{
+  int id;
+  double x, y, theta;
+  double s, d;
+};
+
+// FrenetTracker against the global search of HighwayMap on cars driven frame
+// by frame along the track, one of them across max_s, and ids that jump to
+// another part of the track. the tracker picks the same segment, so both
+// agree exactly, on the hits and on the misses that fall back to the global
+// search. the first lookup of an id and every jump must miss.
+static bool BenchTracker(const BenchMap &bench, mt19937 &rng)
+{
+  const HighwayMap &map = bench.map;
+  double max_s = map.max_s();
+
+  uniform_real_distribution<double> along(0, max_s);
+  uniform_real_distribution<double> speeds(15, 25);
+  uniform_int_distribution<int> lanes(0, 2);
+
+  vector<double> car_s(kTrackedCars), car_d(kTrackedCars), car_speed(kTrackedCars);
+  for (int car = 0; car < kTrackedCars; car++) {
+    // the first car wraps at max_s a couple of seconds in
+    car_s[car] = (car == 0) ? max_s - 40 : along(rng);
+    car_d[car] = 2 + 4 * lanes(rng);
+    car_speed[car] = speeds(rng);
+  }
+
+  vector<TrackedPoint> points;
+  int jumps = 0;
+  for (int frame = 0; frame < kTrackedFrames; frame++) {
+    if (frame > 0 && frame % kJumpFrames == 0) {
+      car_s[frame / kJumpFrames % kTrackedCars] += max_s / 3;
+      jumps++;
+    }
+    for (int car = 0; car < kTrackedCars; car++) {
+      car_s[car] = map.WrapS(car_s[car] + car_speed[car] * 0.02);
+      TrackedPoint point;
+      point.id = car;
+      point.s = car_s[car];
+      point.d = car_d[car];
+      map.getXY(point.s, point.d, point.x, point.y);
+      point.theta = map.heading()[map.PrevWaypoint(point.s)];
+      points.push_back(point);
+    }
+  }
+  int n = points.size();
+  long min_misses = kTrackedCars + jumps;
+
+  const double kTolerance = 1e-9;
+
+  FrenetTracker frenet_tracker(map);
+  FrenetTracker xy_tracker(map);
+  double frenet_error = 0;
+  double xy_error = 0;
+  for (const TrackedPoint &point : points) {
+    double global_s, global_d, tracked_s, tracked_d;
+    map.getFrenet(point.x, point.y, point.theta, global_s, global_d);
+    frenet_tracker.getFrenet(point.id, point.x, point.y, point.theta, tracked_s, tracked_d);
+    frenet_error = max(frenet_error, max(fabs(tracked_s - global_s), fabs(tracked_d - global_d)));
+
+    double global_x, global_y, tracked_x, tracked_y;
+    map.getXY(point.s, point.d, global_x, global_y);
+    xy_tracker.getXY(point.id, point.s, point.d, tracked_x, tracked_y);
+    xy_error = max(xy_error, max(fabs(tracked_x - global_x), fabs(tracked_y - global_y)));
+  }
+  if (!(frenet_error <= kTolerance && xy_error <= kTolerance)) {
+    std::cerr << "FrenetTracker differs from the global search by " << max(frenet_error, xy_error) << " m for ";
+    std::cerr << map.size() << " waypoints" << std::endl;
+    return false;
+  }
+  if (frenet_tracker.misses() < min_misses || xy_tracker.misses() < min_misses) {
+    std::cerr << "FrenetTracker took the hint on a new or jumped id for " << map.size() << " waypoints" << std::endl;
+    return false;
+  }
+
+  double sink = 0;
+
+  auto start = chrono::steady_clock::now();
+  for (const TrackedPoint &point : points) {
+    double s, d;
+    map.getFrenet(point.x, point.y, point.theta, s, d);
+    sink += s;
+  }
+  double frenet_global_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+
+  FrenetTracker timed_frenet(map);
+  start = chrono::steady_clock::now();
+  for (const TrackedPoint &point : points) {
+    double s, d;
+    timed_frenet.getFrenet(point.id, point.x, point.y, point.theta, s, d);
+    sink += s;
+  }
+  double frenet_tracked_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+
+  start = chrono::steady_clock::now();
+  for (const TrackedPoint &point : points) {
+    double x, y;
+    map.getXY(point.s, point.d, x, y);
+    sink += x;
+  }
+  double xy_global_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+
+  FrenetTracker timed_xy(map);
+  start = chrono::steady_clock::now();
+  for (const TrackedPoint &point : points) {
+    double x, y;
+    timed_xy.getXY(point.id, point.s, point.d, x, y);
+    sink += x;
+  }
+  double xy_tracked_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+
+  printf("%9d  %7d  %12.1f  %16.1f  %17.1f  %8.1f  %12.1f  %13.1f  %11.2g%s\n", map.size(), n,
+         100.0 * frenet_tracker.hits() / n, frenet_global_ns, frenet_tracked_ns, 100.0 * xy_tracker.hits() / n,
+         xy_global_ns, xy_tracked_ns, max(frenet_error, xy_error), sink == 0 ? " " : "");
+  return true;
+}
+
+static const int kBatchPoints = 100000;
+
+// the batch conversions against their scalar versions on random points, with s
+// also before 0 and past max_s. the batch loops do the same arithmetic in the
+// same order, so they agree exactly unless the compiler fuses multiply-adds
+// differently in the two, which stays far below kTolerance.
+static bool BenchBatch(const BenchMap &bench, mt19937 &rng)
+{
+  const HighwayMap &map = bench.map;
+  const ReferenceLine &line = bench.line;
+  int n = kBatchPoints;
+
+  uniform_real_distribution<double> along(-map.max_s(), 2 * map.max_s());
+  uniform_real_distribution<double> across(-2, 14);
+  uniform_real_distribution<double> lanes(0, 12);
+
+  vector<double> s(n), d(n), x(n), y(n), theta(n);
+  for (int i = 0; i < n; i++) {
+    s[i] = along(rng);
+    d[i] = across(rng);
+    // the points getFrenet is given are on the road, heading along it
+    double on_s = map.WrapS(s[i]);
+    map.getXY(on_s, lanes(rng), x[i], y[i]);
+    theta[i] = map.heading()[map.PrevWaypoint(on_s)];
+  }
+
+  const double kTolerance = 1e-9;
+  vector<double> batch_a(n), batch_b(n);
+
+  double sink = 0;
+
+  // getFrenet
+  map.getFrenetBatch(x.data(), y.data(), theta.data(), batch_a.data(), batch_b.data(), n);
+  double frenet_error = 0;
+  for (int i = 0; i < n; i++) {
+    double scalar_s, scalar_d;
+    map.getFrenet(x[i], y[i], theta[i], scalar_s, scalar_d);
+    frenet_error = max(frenet_error, max(fabs(batch_a[i] - scalar_s), fabs(batch_b[i] - scalar_d)));
+  }
+  if (!(frenet_error <= kTolerance)) {
+    std::cerr << "getFrenetBatch differs from getFrenet by " << frenet_error << " m for " << map.size();
+    std::cerr << " waypoints" << std::endl;
+    return false;
+  }
+
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    double scalar_s, scalar_d;
+    map.getFrenet(x[i], y[i], theta[i], scalar_s, scalar_d);
+    sink += scalar_s;
+  }
+  double frenet_scalar_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+
+  start = chrono::steady_clock::now();
+  map.getFrenetBatch(x.data(), y.data(), theta.data(), batch_a.data(), batch_b.data(), n);
+  double frenet_batch_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+  sink += batch_a[n - 1];
+
+  // getXY on the reference line
+  line.getXYBatch(s.data(), d.data(), batch_a.data(), batch_b.data(), n);
+  double xy_error = 0;
+  for (int i = 0; i < n; i++) {
+    double scalar_x, scalar_y;
+    line.getXY(s[i], d[i], scalar_x, scalar_y);
+    xy_error = max(xy_error, max(fabs(batch_a[i] - scalar_x), fabs(batch_b[i] - scalar_y)));
+  }
+  if (!(xy_error <= kTolerance)) {
+    std::cerr << "getXYBatch differs from getXY by " << xy_error << " m for " << map.size() << " waypoints";
+    std::cerr << std::endl;
+    return false;
+  }
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    double scalar_x, scalar_y;
+    line.getXY(s[i], d[i], scalar_x, scalar_y);
+    sink += scalar_x;
+  }
+  double xy_scalar_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+
+  start = chrono::steady_clock::now();
+  line.getXYBatch(s.data(), d.data(), batch_a.data(), batch_b.data(), n);
+  double xy_batch_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+  sink += batch_a[n - 1];
+
+  printf("%9d  %16.1f  %15.1f  %11.2g  %12.1f  %11.1f  %11.2g%s\n", map.size(), frenet_scalar_ns, frenet_batch_ns,
+         frenet_error, xy_scalar_ns, xy_batch_ns, xy_error, sink == 0 ? " " : "");
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int num_queries = (argc > 1) ? atoi(argv[1]) : 2000;
+  if (num_queries < 1) {
+    std::cerr << "usage: map_bench [queries]" << std::endl;
+    return 1;
+  }
+
+  MapWaypoints track_waypoints;
+  if (!LoadMapCsv(kMapCsvFile, track_waypoints)) {
+    std::cerr << "Failed to read " << kMapCsvFile << ", run from the build directory" << std::endl;
+    return 1;
+  }
+  HighwayMap track;
+  track.Build(track_waypoints, kMapMaxS);
+
+  mt19937 rng(42);
+
+  // the track as it is, then resampled ever finer
+  vector<unique_ptr<BenchMap> > maps;
+  const int sizes[] = {0, 1000, 10000, 100000};
+  for (int size : sizes) {
+    maps.push_back(unique_ptr<BenchMap>(new BenchMap()));
+    BenchMap &bench = *maps.back();
+    if (size == 0) {
+      bench.waypoints = track_waypoints;
+    } else {
+      ResampleTrack(track, size, bench.waypoints);
+    }
+    bench.map.Build(bench.waypoints, size == 0 ? track.max_s() : TrackLength(bench.waypoints));
+    bench.line.Build(bench.map);
+    MakeQueries(bench.map, num_queries, rng, bench.queries);
+  }
+
+  std::cout << "closest waypoint" << std::endl;
+  std::cout << "waypoints  linear us/query  kd-tree us/query  speedup" << std::endl;
+  for (auto &bench : maps) {
+    if (!BenchClosest(*bench)) {
+      return 1;
+    }
+  }
+
+  // the summed s costs a pass over the waypoints per point, only the smaller maps are checked
+  std::cout << std::endl << "getFrenet s against the summed s" << std::endl;
+  std::cout << "waypoints  points  max error m" << std::endl;
+  for (auto &bench : maps) {
+    if (bench->map.size() <= 10000 && !CheckFrenet(*bench)) {
+      return 1;
+    }
+  }
+
+  // the previous getFrenet also found the closest waypoint with the linear scan
+  std::cout << std::endl << "getFrenet, previous against the k-d tree and the s table" << std::endl;
+  std::cout << "waypoints  summed us/query  table us/query  speedup" << std::endl;
+  for (auto &bench : maps) {
+    BenchFrenet(*bench);
+  }
+
+  std::cout << std::endl << "getXY segment search" << std::endl;
+  std::cout << "waypoints  linear us/query  binary us/query  speedup" << std::endl;
+  for (auto &bench : maps) {
+    if (!BenchXYSearch(*bench)) {
+      return 1;
+    }
+  }
+
+  std::cout << std::endl << "getXY, frenet.cpp against the tangent table" << std::endl;
+  std::cout << "waypoints  trig us/query  tangent us/query  speedup  max error m" << std::endl;
+  for (auto &bench : maps) {
+    if (!BenchXYTangent(*bench)) {
+      return 1;
+    }
+  }
+
+  std::cout << std::endl << "getXY, frenet.cpp against the 0.5 m reference line" << std::endl;
+  std::cout << "waypoints  samples      KiB  build ms  trig ns/query  line ns/query  speedup  center err m";
+  std::cout << "  max difference m" << std::endl;
+  for (auto &bench : maps) {
+    if (!BenchReferenceLine(*bench)) {
+      return 1;
+    }
+  }
+
+  std::cout << std::endl << "FrenetTracker against the global search, " << kTrackedCars << " cars driven ";
+  std::cout << kTrackedFrames << " frames" << std::endl;
+  std::cout << "waypoints  lookups  frenet hit %  frenet global ns  frenet tracked ns  xy hit %  xy global ns";
+  std::cout << "  xy tracked ns  max error m" << std::endl;
+  for (auto &bench : maps) {
+    if (!BenchTracker(*bench, rng)) {
+      return 1;
+    }
+  }
+
+  std::cout << std::endl << "batch conversions against the scalar ones, " << kBatchPoints << " points" << std::endl;
+  std::cout << "waypoints  frenet scalar ns  frenet batch ns  max error m  xy scalar ns  xy batch ns  max error m";
+  std::cout << std::endl;
+  for (auto &bench : maps) {
+    if (!BenchBatch(*bench, rng)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,64 @@
+// offline converter from the csv waypoint map to the binary map format.
+//
+// usage: map_convert [--tiles <tile_length>] <map.csv> <map.bin> [max_s]
+//
+// max_s defaults to the s of the last waypoint plus the closing segment back
+// to the first one, which is 6945.554 for data/highway_map.csv.
+// with --tiles the output is a tiled map, cut into tiles of tile_length meters
+// of s, that the planner streams in around the car. meant for long routes.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <string>
+
+#include "highway_map.h"
+#include "tiled_map.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+  double tile_length = 0;
+  if (argc > 2 && strcmp(argv[1], "--tiles") == 0) {
+    tile_length = atof(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
+
+  if (argc < 3 || argc > 4) {
+    std::cerr << "usage: map_convert [--tiles <tile_length>] <map.csv> <map.bin> [max_s]" << std::endl;
+    return 1;
+  }
+
+  MapWaypoints waypoints;
+  if (!LoadMapCsv(argv[1], waypoints) || waypoints.x.size() < 2) {
+    std::cerr << "Failed to read waypoints from " << argv[1] << std::endl;
+    return 1;
+  }
+
+  double max_s = (argc == 4) ? atof(argv[3]) : TrackLength(waypoints);
+
+  if (tile_length > 0) {
+    if (!WriteTiledMap(argv[2], waypoints, max_s, tile_length)) {
+      std::cerr << "Failed to write " << argv[2] << std::endl;
+      return 1;
+    }
+
+    std::cout << "Wrote " << waypoints.x.size() << " waypoints, max_s " << max_s;
+    std::cout << " in tiles of " << tile_length << " m to " << argv[2] << std::endl;
+    return 0;
+  }
+
+  HighwayMap map;
+  map.Build(waypoints, max_s);
+
+  if (!map.Save(argv[2])) {
+    std::cerr << "Failed to write " << argv[2] << std::endl;
+    return 1;
+  }
+
+  std::cout << "Wrote " << waypoints.x.size() << " waypoints, max_s " << max_s;
+  std::cout << " to " << argv[2] << std::endl;
+  return 0;
+}
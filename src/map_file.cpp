@@ -0,0 +1,163 @@
+#include "map_file.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "frenet.h"
+
+using namespace std;
+
+static uint64_t AlignUp(uint64_t offset)
+{
+  return (offset + kMapSectionAlign - 1) / kMapSectionAlign * kMapSectionAlign;
+}
+
+size_t MapSectionEntrySize(int section)
+{
+  return (section == kSectionTreeIndex) ? sizeof(int32_t) : sizeof(double);
+}
+
+uint64_t MapFileLayout(uint32_t n, double max_s, MapFileHeader &header)
+{
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMapFileMagic, sizeof(header.magic));
+  header.version = kMapFileVersion;
+  header.num_waypoints = n;
+  header.max_s = max_s;
+
+  uint64_t offset = AlignUp(sizeof(header));
+  for(int i = 0; i < kNumSections; i++)
+  {
+    header.section_offset[i] = offset;
+    offset = AlignUp(offset + n * MapSectionEntrySize(i));
+  }
+
+  return offset;
+}
+
+bool LoadMapCsv(const string &path, MapWaypoints &waypoints)
+{
+  ifstream in_map_(path.c_str(), ifstream::in);
+  if(!in_map_)
+  {
+    return false;
+  }
+
+  string line;
+  while (getline(in_map_, line)) {
+    istringstream iss(line);
+    double x;
+    double y;
+    double s;
+    double d_x;
+    double d_y;
+    if(!(iss >> x >> y >> s >> d_x >> d_y))
+    {
+      continue;
+    }
+    waypoints.x.push_back(x);
+    waypoints.y.push_back(y);
+    waypoints.s.push_back(s);
+    waypoints.dx.push_back(d_x);
+    waypoints.dy.push_back(d_y);
+  }
+
+  return !waypoints.x.empty();
+}
+
+double TrackLength(const MapWaypoints &waypoints)
+{
+  int last = waypoints.x.size() - 1;
+
+  return waypoints.s[last] + distance(waypoints.x[last], waypoints.y[last], waypoints.x[0], waypoints.y[0]);
+}
+
+MapFile::MapFile()
+  : data_(MAP_FAILED), length_(0), header_(NULL)
+{
+}
+
+MapFile::~MapFile()
+{
+  Close();
+}
+
+bool MapFile::Open(const string &path)
+{
+  Close();
+  error_.clear();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    error_ = "can't open " + path;
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MapFileHeader))
+  {
+    close(fd);
+    error_ = path + " is too short for a map file";
+    return false;
+  }
+
+  length_ = st.st_size;
+  data_ = mmap(NULL, length_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(data_ == MAP_FAILED)
+  {
+    error_ = "can't map " + path;
+    return false;
+  }
+
+  header_ = (const MapFileHeader *)data_;
+
+  if(memcmp(header_->magic, kMapFileMagic, sizeof(kMapFileMagic)) != 0)
+  {
+    error_ = path + " is not a map file";
+  }
+  else if(header_->version != kMapFileVersion)
+  {
+    error_ = path + " has an unsupported map file version";
+  }
+  else if(header_->num_waypoints < 2)
+  {
+    error_ = path + " has less than two waypoints";
+  }
+
+  for(int i = 0; error_.empty() && i < kNumSections; i++)
+  {
+    size_t entry = MapSectionEntrySize(i);
+    uint64_t offset = header_->section_offset[i];
+    if(offset % kMapSectionAlign != 0 || offset > length_ || (length_ - offset) / entry < header_->num_waypoints)
+    {
+      error_ = path + " is truncated or has a bad section table";
+    }
+  }
+
+  if(!error_.empty())
+  {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+void MapFile::Close()
+{
+  if(data_ != MAP_FAILED)
+  {
+    munmap(data_, length_);
+  }
+  data_ = MAP_FAILED;
+  length_ = 0;
+  header_ = NULL;
+}
@@ -0,0 +1,103 @@
+#ifndef MAP_FILE_H
+#define MAP_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// versioned binary map format. map_convert writes it offline from the csv map,
+// together with everything that is otherwise derived at startup, and the
+// planner maps it into memory read-only instead of parsing text.
+//
+// layout: a MapFileHeader followed by the sections listed in MapSection.
+// every section is a plain little-endian array of num_waypoints entries
+// (double, or int32 for the tree index) that starts on a 64 byte boundary.
+// HighwayMap keeps maps built in memory in the same layout.
+
+static const char kMapFileMagic[8] = {'P', 'P', 'M', 'A', 'P', 0, 0, 0};
+static const uint32_t kMapFileVersion = 3;
+
+// sections start on cache line boundaries
+static const uint64_t kMapSectionAlign = 64;
+
+enum MapSection
+{
+  kSectionX,            // waypoint x
+  kSectionY,            // waypoint y
+  kSectionS,            // waypoint s
+  kSectionDx,           // waypoint normal x
+  kSectionDy,           // waypoint normal y
+  kSectionCumS,         // path length from waypoint 0, see CumulativeDistance
+  kSectionLength,       // length of the segment starting at the waypoint
+  kSectionHeading,      // heading of the segment starting at the waypoint
+  kSectionTangentX,     // unit tangent of the segment, x
+  kSectionTangentY,     // unit tangent of the segment, y
+  kSectionNormalX,      // unit normal to the right of the segment, x
+  kSectionNormalY,      // unit normal to the right of the segment, y
+  kSectionTreeIndex,    // WaypointKdTree node order, int32
+  kSectionTreeX,        // waypoint x in tree order
+  kSectionTreeY,        // waypoint y in tree order
+  kNumSections
+};
+
+struct MapFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t num_waypoints;
+  double max_s;
+  uint64_t section_offset[kNumSections];
+};
+
+// size of one entry of a section
+size_t MapSectionEntrySize(int section);
+
+// fill in magic, version and section offsets for n waypoints, returns the total image size
+uint64_t MapFileLayout(uint32_t n, double max_s, MapFileHeader &header);
+
+// waypoints as read from a map file
+struct MapWaypoints
+{
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> s;
+  std::vector<double> dx;
+  std::vector<double> dy;
+};
+
+// read the csv map, all columns as double. returns false if the file can't be read.
+bool LoadMapCsv(const std::string &path, MapWaypoints &waypoints);
+
+// track length: s of the last waypoint plus the closing segment back to the first one
+double TrackLength(const MapWaypoints &waypoints);
+
+// read-only memory mapping of a binary map file
+class MapFile
+{
+public:
+  MapFile();
+  ~MapFile();
+
+  // map the file and check header and section bounds, false with error() set on failure
+  bool Open(const std::string &path);
+  void Close();
+
+  const std::string &error() const { return error_; }
+
+  // the whole file image, starting with the MapFileHeader
+  const void *data() const { return data_; }
+  size_t length() const { return length_; }
+  const MapFileHeader &header() const { return *header_; }
+
+private:
+  MapFile(const MapFile &);
+  MapFile &operator=(const MapFile &);
+
+  void *data_;
+  size_t length_;
+  const MapFileHeader *header_;
+  std::string error_;
+};
+
+#endif // MAP_FILE_H
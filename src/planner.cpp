@@ -0,0 +1,597 @@
+#include "planner.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "frenet.h"
+#include "spline.h"                     // spline tool
+
+using namespace std;
+
+// for converting back and forth between radians and degrees.
+double deg2rad(double x) { return x * pi() / 180; }
+double rad2deg(double x) { return x * 180 / pi(); }
+
+bool PlannerMap::Load(const string &tiles_file, const string &bin_file, const string &csv_file, double max_s, ostream &log)
+{
+  auto map_start = chrono::steady_clock::now();
+  string map_error;
+  use_tiles = tiled_map.Open(tiles_file, map_error);
+  if (use_tiles) {
+    double map_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - map_start).count();
+
+    log << "Map: " << tiled_map.num_tiles() << " tiles of " << tiled_map.tile_length() << " m, ";
+    log << "directory loaded in " << map_ms << " ms" << endl;
+    return true;
+  }
+
+  if (!map.Open(bin_file, map_error)) {
+    // load up map values for waypoint's x,y,s and d normalized normal vectors
+    MapWaypoints map_waypoints;
+    if (!LoadMapCsv(csv_file, map_waypoints)) {
+      std::cerr << "Failed to load map from " << bin_file << " or " << csv_file << std::endl;
+      return false;
+    }
+    map.Build(map_waypoints, max_s);
+  }
+  double map_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - map_start).count();
+
+  log << "Map: " << map.size() << " waypoints, loaded in " << map_ms << " ms" << endl;
+
+  auto ref_line_start = chrono::steady_clock::now();
+  ref_line.Build(map);
+  double ref_line_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - ref_line_start).count();
+
+  log << "Reference line: " << ref_line.size() << " samples every " << ref_line.step() << " m, ";
+  log << ref_line.bytes() / 1024 << " KiB, built in " << ref_line_ms << " ms" << endl;
+  return true;
+}
+
+Planner::Planner(PlannerMap &map)
+  : map_(map), lane_(1), lc_alg_(false), ref_vel_(0), log_(&std::cout), deadline_us_(0), truncated_(false), plans_(0),
+    truncated_plans_(0)
+{
+}
+
+bool Planner::OnMessage(const char *data, size_t length, bool binary, const char *&reply, size_t &reply_length)
+{
+  if (deadline_us_ > 0) {
+    deadline_ = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(
+                                                  chrono::duration<double, micro>(deadline_us_));
+  }
+  truncated_ = false;
+
+  // the frame is decoded in place into telemetry, see DecodeTelemetry
+  TelemetryEvent event = binary ? DecodeBinaryTelemetry(data, length, telemetry_)
+                                : DecodeTelemetry(data, length, telemetry_);
+
+  if (event == kEventTelemetry) {
+    Plan(binary);
+    arena_.Reset();
+    plans_++;
+    if (truncated_) {
+      truncated_plans_++;
+    }
+    reply = control_message_.data();
+    reply_length = control_message_.length();
+    return true;
+  }
+
+  // binary clients have no manual mode, a frame that doesn't decode goes unanswered
+  if (!binary && (event == kEventManual || event == kEventInvalid)) {
+    // Manual driving
+    static const char kManual[] = "42[\"manual\",{}]";
+    reply = kManual;
+    reply_length = sizeof(kManual) - 1;
+    return true;
+  }
+
+  return false;
+}
+
+void Planner::Plan(bool binary)
+{
+  // the planner state and the map under the names the planning code uses
+  const Telemetry &telemetry = telemetry_;
+  int &lane = lane_;
+  bool &lc_alg = lc_alg_;
+  double &ref_vel = ref_vel_;
+  const ReferenceLine &ref_line = map_.ref_line;
+  TiledMap &tiled_map = map_.tiled_map;
+  bool use_tiles = map_.use_tiles;
+  ostream &log = *log_;
+
+  // every container of the frame takes its memory from the arena
+  ArenaAllocator<double> alloc(&arena_);
+
+	// main car's localization data
+  	double car_x = telemetry.x;
+  	double car_y = telemetry.y;
+  	double car_s = telemetry.s;
+  	double car_yaw = telemetry.yaw;
+
+    // std::cout << "car_x " << car_x << endl;
+    // std::cout << "car_y " << car_y << endl;
+    // std::cout << "car_yaw " << car_yaw << endl;
+    // std::cout << "car_s " << car_s << endl;
+
+  	// previous path data given to the Planner
+  	const double *previous_path_x = telemetry.previous_path_x;
+  	const double *previous_path_y = telemetry.previous_path_y;
+
+    // size of previous path
+    int prev_size = telemetry.prev_size;
+
+  	// previous path's end s value
+  	double end_path_s = telemetry.end_path_s;
+
+  	// sensor fusion data
+    // a list of all other cars on the same side of the road
+  	const SensorFusionRow *sensor_fusion = telemetry.sensor_fusion;
+
+    if(prev_size > 0)
+    {
+        car_s = end_path_s;
+    }
+
+    // bool variable for checking, if car in front is too close
+    bool too_close = false;
+
+    // bool variables to enable lane changes
+    bool change_left = false;
+    bool change_right = false;
+
+    // lists to store indices of cars in lanes left or right of the car
+    ArenaVector<int> leftcars(alloc);
+    ArenaVector<int> rightcars(alloc);
+    leftcars.reserve(telemetry.num_cars);
+    rightcars.reserve(telemetry.num_cars);
+
+    // check for cars ahead
+    for (int i = 0; i < telemetry.num_cars; i++)
+    {
+        const SensorFusionRow &check_car = sensor_fusion[i];
+
+        // car is in my lane
+        float d = check_car.d;
+        if(d < (4. * (lane+1)) && d > (4. * lane))
+        {
+            double check_speed = check_car.speed;
+            double check_car_s = check_car.s;
+
+            // if using previos points can project s value outward some time
+            check_car_s += ((double)prev_size * 0.02 * check_speed);
+
+            // check s values greater than mine and s gap
+            if ((check_car_s > car_s) && (check_car_s - car_s) < 30.)
+            {
+
+                // enable algorithm to check for lane changes
+                lc_alg = true;
+
+                // set bool flag too close
+                too_close = true;
+
+                // lower target speed dependent on distance and speed difference
+                if((check_car_s - car_s) < 10.)
+                {
+                    ref_vel -= .224;
+                }
+
+                // the decrease is relative to our speed, there is none to
+                // lose at a standstill
+                else if(ref_vel > (check_speed - 3.))
+                {
+                    if(ref_vel > 0)
+                    {
+                        ref_vel -= .224 * (abs(ref_vel - check_speed) / ref_vel) * (15 / (check_car_s - car_s));
+                    }
+                }
+
+                // the decrease is relative to the speed of the car ahead, a
+                // standing one is matched right away
+                else if(abs(ref_vel - check_speed) <= 3.)
+                {
+                    if(check_speed > 0)
+                    {
+                        ref_vel -= (ref_vel - check_speed) / check_speed * .224;
+                    }
+                    else
+                    {
+                        ref_vel = 0;
+                    }
+                }
+
+                log << "Car in front of us is too close: Lowering speed. Target speed: ";
+                log <<  ref_vel << endl;
+
+            }
+        }
+
+        // store car number for cars that are not in my lane, but in the lane right of me
+        else if (d < (4. * (lane+2)) && d > (4. * (lane+1)))
+        {
+            rightcars.push_back(i);
+        }
+
+        // store car number for cars that are not in my lane, but in the lane left of me
+        else if (d < (4. * lane) && d > (4. * (lane-1)))
+        {
+            leftcars.push_back(i);
+        }
+
+    }
+
+    // lane change algorithm enabled
+    if(lc_alg)
+    {
+
+        // variables to check for distance
+        double min_dist_s_left = 100.;
+        double min_dist_s_right = 100.;
+
+        // variables to store the minimum speed of cars in front of us in other lanes
+        double min_speed_left_lane = 50.;
+        double min_speed_right_lane = 50.;
+
+        // the lanes are evaluated in order of priority, as long as the
+        // deadline leaves time for them. it's checked before every lane and
+        // between its cars, so a long list of cars can't hold the frame up.
+        // keeping the lane needs none of them, a lane that wasn't evaluated
+        // to its last car is not changed into.
+        bool left_evaluated = false;
+        bool right_evaluated = false;
+
+        if(!DeadlinePassed())
+        {
+            // check if left lane is blocked:
+            // - find minimum distance to cars in left lane
+            // - find minimum speed of cars in front of us in left lane
+            left_evaluated = true;
+            for(size_t i = 0; left_evaluated && i < leftcars.size(); i++)
+            {
+                const SensorFusionRow &check_car = sensor_fusion[leftcars[i]];
+                double check_car_s = check_car.s;
+                double check_speed = check_car.speed;
+                double dist_to_car = abs(check_car_s - car_s);
+
+                // if using previos points can project s value outward some time
+                check_car_s += ((double)prev_size * 0.02 * check_speed);
+
+                // if distance is below min distance, set to min distance
+                if (dist_to_car < min_dist_s_left)
+                {
+                    // exclude cars that are behind us with lower speed
+                    if((check_speed + 5.) > ref_vel || check_car_s > (car_s - 10.))
+                    {
+                        min_dist_s_left = dist_to_car;
+                    }
+                }
+                // if car is in front of us with distance up to 60 and speed is below minimum, set to min speed
+                if((check_car_s > car_s) && (dist_to_car < 60.) && (check_speed < min_speed_left_lane))
+                {
+                    min_speed_left_lane = check_speed;
+                }
+
+                if(i + 1 < leftcars.size() && DeadlinePassed())
+                {
+                    left_evaluated = false;
+                }
+            }
+        }
+
+        if(!DeadlinePassed())
+        {
+            // check if right lane is blocked:
+            // - find minimum distance to cars in right lane
+            // - find minimum speed of cars in front of us in right lane
+            right_evaluated = true;
+            for(size_t i = 0; right_evaluated && i < rightcars.size(); i++)
+            {
+                const SensorFusionRow &check_car = sensor_fusion[rightcars[i]];
+                double check_car_s = check_car.s;
+                double check_speed = check_car.speed;
+                double dist_to_car = abs(check_car_s - car_s);
+
+                // if using previos points can project s value outward some time
+                check_car_s += ((double)prev_size * 0.02 * check_speed);
+
+                // if distance is below min distance, set to min distance
+                if (dist_to_car < min_dist_s_right)
+                {
+                    // exclude cars that are behind us with lower speed
+                    if((check_speed + 5.) > ref_vel || check_car_s > (car_s - 10.))
+                    {
+                        min_dist_s_right = dist_to_car;
+                    }
+                }
+                // if car is in front of us with distance up to 60 and speed is below minimum, set to min speed
+                if((check_car_s > car_s) && (dist_to_car < 60.) && (check_speed < min_speed_right_lane))
+                {
+                    min_speed_right_lane = check_speed;
+                }
+
+                if(i + 1 < rightcars.size() && DeadlinePassed())
+                {
+                    right_evaluated = false;
+                }
+            }
+        }
+
+        if(!left_evaluated || !right_evaluated)
+        {
+            truncated_ = true;
+        }
+
+        // std::cout << "min_dist_s_left: " << min_dist_s_left;
+        // std::cout << " min_dist_s_right: " << min_dist_s_right << endl;
+
+        // if other cars are at safe distance and car is not in border lane enable lane change.
+        // the safe distance grows as we slow down, a car at a standstill doesn't change lanes.
+        if (left_evaluated && ref_vel > 0 && min_dist_s_left > (30 * 49.5 / ref_vel) && (lane >= 1))
+        {
+            log << "Left lane is free. Min distance: " << min_dist_s_left;
+            log << " Min speed in left lane: " << min_speed_left_lane << endl;
+            change_left = true;
+        }
+        if (right_evaluated && ref_vel > 0 && min_dist_s_right > 30 * 49.5 / ref_vel && (lane <= 1))
+        {
+            log << "Right lane is free. Min distance: " << min_dist_s_right;
+            log << " Min speed in right lane: " << min_speed_right_lane << endl;
+            change_right = true;
+        }
+
+        // if both lanes are free, compare speeds of cars driving ahead of us
+        // and change into faster lane, if faster than our lane
+        if (change_left && change_right && (ref_vel < (min(min_speed_left_lane, min_speed_right_lane))))
+        {
+            log << "Both lanes are free." << endl;
+
+            if(min_speed_left_lane >= min_speed_right_lane)
+            {
+                // change lane to left and output msg
+                lane -= 1;
+                log << "Changing lanes to the left." << endl;
+                // reset lane changing algorithm
+                lc_alg = false;
+            }
+
+            else if(min_speed_left_lane < min_speed_right_lane)
+            {
+                // change lane to right and output msg
+                lane += 1;
+                log << "Changing lanes to the right." << endl;
+                // reset lane changing algorithm
+                lc_alg = false;
+            }
+        }
+
+        // if only one lane is free change to that, ...
+        else
+        {
+
+            // if speed is faster in the free lane and you are not already in the border left lane
+            if(change_left && (ref_vel < min_speed_left_lane))
+            {
+
+                // change lane to left and output msg
+                lane -= 1;
+                log << "Changing lanes to the left." << endl;
+
+                // reset lane changing algorithm
+                lc_alg = false;
+
+            }
+
+            // if speed is faster in the free lane and you are not already in the border right lane
+            else if(change_right && (ref_vel < min_speed_right_lane))
+            {
+
+                // change lane to right and output msg
+                lane += 1;
+                log << "Changing lanes to the right." << endl;
+
+                // reset lane changing algorithm
+                lc_alg = false;
+
+            }
+        }
+
+    }
+
+    // speed up, if no car in front
+    if(ref_vel < 49.5 && (!too_close))
+    {
+        log << "Speeding up. Target speed: " << ref_vel << endl;
+        ref_vel += .224;
+    }
+
+    // braking hard behind a slow car can overshoot below standstill, which
+    // would plan the path backwards
+    if(ref_vel < 0)
+    {
+        ref_vel = 0;
+    }
+
+    // create a list of widely spread (x,y) waypoints, evenly spread at 30m
+    // later we will interpolate these waypoints with a spline and fill it in with more points that control spline
+    ArenaVector<double> ptsx(alloc);
+    ArenaVector<double> ptsy(alloc);
+    ptsx.reserve(5);
+    ptsy.reserve(5);
+
+    // reference x, y, yaw states
+    // either we will reference the starting point as where the car is or at the previous paths end point
+    double ref_x = car_x;
+    double ref_y = car_y;
+    double ref_yaw = deg2rad(car_yaw);
+
+    // if previous path is almost empty, use the car as starting reference
+    if(prev_size < 2)
+    {
+        // use two points that make the path tangent to the car
+        double prev_car_x = car_x - cos(ref_yaw);
+        double prev_car_y = car_y - sin(ref_yaw);
+
+        ptsx.push_back(prev_car_x);
+        ptsx.push_back(car_x);
+
+        ptsy.push_back(prev_car_y);
+        ptsy.push_back(car_y);
+    }
+
+    // use the previous path's end point as starting reference
+    else
+    {
+        // redefine reference state as previous path end point
+        ref_x = previous_path_x[prev_size - 1];
+        ref_y = previous_path_y[prev_size - 1];
+
+        double ref_x_prev = previous_path_x[prev_size - 2];
+        double ref_y_prev = previous_path_y[prev_size - 2];
+
+        // a path planned at standstill ends in the same point twice, which has
+        // no heading and would leave the spline points out of order. keep the
+        // car's heading then, one session must not bring down the process.
+        if(ref_x == ref_x_prev && ref_y == ref_y_prev)
+        {
+            ref_x_prev = ref_x - cos(ref_yaw);
+            ref_y_prev = ref_y - sin(ref_yaw);
+        }
+        ref_yaw = atan2(ref_y - ref_y_prev, ref_x - ref_x_prev);
+
+        // use two points that make the path tangent to the previous path's end point
+        ptsx.push_back(ref_x_prev);
+        ptsx.push_back(ref_x);
+
+        ptsy.push_back(ref_y_prev);
+        ptsy.push_back(ref_y);
+
+    }
+
+    // in freenet add evenly 30m spaced points ahead of the starting reference
+    double next_wp0[2];
+    double next_wp1[2];
+    double next_wp2[2];
+    if (use_tiles)
+    {
+        // have the tiles around the car loaded before the next frames need them
+        tiled_map.Prefetch(car_s);
+
+        if (!tiled_map.getXY(car_s + 30, (2 + 4*lane), next_wp0[0], next_wp0[1]) ||
+            !tiled_map.getXY(car_s + 60, (2 + 4*lane), next_wp1[0], next_wp1[1]) ||
+            !tiled_map.getXY(car_s + 90, (2 + 4*lane), next_wp2[0], next_wp2[1]))
+        {
+            // the tile is read again next frame, until then the car keeps to
+            // the path it has
+            log << "Map tile unreadable, keeping the previous path" << endl;
+            WriteControl(binary, previous_path_x, previous_path_y, prev_size, prev_size);
+            return;
+        }
+    }
+    else
+    {
+        ref_line.getXY(car_s + 30, (2 + 4*lane), next_wp0[0], next_wp0[1]);
+        ref_line.getXY(car_s + 60, (2 + 4*lane), next_wp1[0], next_wp1[1]);
+        ref_line.getXY(car_s + 90, (2 + 4*lane), next_wp2[0], next_wp2[1]);
+    }
+
+    ptsx.push_back(next_wp0[0]);
+    ptsx.push_back(next_wp1[0]);
+    ptsx.push_back(next_wp2[0]);
+
+    ptsy.push_back(next_wp0[1]);
+    ptsy.push_back(next_wp1[1]);
+    ptsy.push_back(next_wp2[1]);
+
+    for (size_t i = 0; i < ptsx.size(); i++)
+    {
+        // shift car reference angle to 0 degrees
+        double shift_x = ptsx[i] - ref_x;
+        double shift_y = ptsy[i] - ref_y;
+
+        ptsx[i] = (shift_x * cos(0 - ref_yaw) - shift_y * sin(0 - ref_yaw));
+        ptsy[i] = (shift_x * sin(0 - ref_yaw) + shift_y * cos(0 - ref_yaw));
+
+    }
+
+    // create a spline
+    tk::basic_spline<ArenaAllocator<double> > s(alloc);
+
+    // set (x,y) points to the spline
+    s.set_points(ptsx, ptsy);
+
+    // define the actual (x,y) points we will use for the planner
+    ArenaVector<double> next_x_vals(alloc);
+    ArenaVector<double> next_y_vals(alloc);
+    next_x_vals.reserve(max(prev_size, 50));
+    next_y_vals.reserve(max(prev_size, 50));
+
+    // start with all of the previous path points from last time
+    for (int i = 0; i < prev_size; i++)
+    {
+        next_x_vals.push_back(previous_path_x[i]);
+        next_y_vals.push_back(previous_path_y[i]);
+    }
+
+    // calculate how to break up spline points, so that we travel at our desired reference velocity
+    double target_x = 30.0;
+    double target_y = s(target_x);
+    double target_dist = sqrt(target_x * target_x + target_y * target_y);
+
+    double x_add_on = 0;
+
+    // fill up the rest of our path planner after filling it with previous points, here we will always output 50 points
+    for (int i = 1; i <= 50 - prev_size; i++)
+    {
+        // at a standstill the new points stay where the path ends
+        double x_point = x_add_on;
+        if(ref_vel > 0)
+        {
+            double N = (target_dist / (0.02 * ref_vel / 2.24));
+            x_point += (target_x / N);
+        }
+        double y_point = s(x_point);
+
+        x_add_on = x_point;
+
+        double x_ref = x_point;
+        double y_ref = y_point;
+
+        // rotate back to normal after rotating it earlier
+        x_point = (x_ref * cos(ref_yaw) - y_ref * sin(ref_yaw));
+        y_point = (x_ref * sin(ref_yaw) + y_ref * cos(ref_yaw));
+
+        x_point += ref_x;
+        y_point += ref_y;
+
+        next_x_vals.push_back(x_point);
+        next_y_vals.push_back(y_point);
+
+    }
+
+    WriteControl(binary, next_x_vals.data(), next_y_vals.data(), next_x_vals.size(), prev_size);
+}
+
+void Planner::WriteControl(bool binary, const double *x, const double *y, int size, int prev_size)
+{
+  if (telemetry_.delta) {
+    // the previous path goes back unchanged, a client that asked for deltas
+    // still has it and only gets the points appended to it
+    int appended = size - prev_size;
+    if (binary) {
+      control_message_.WriteBinaryDelta(telemetry_.seq, prev_size, x + prev_size, y + prev_size, appended);
+    } else {
+      control_message_.WriteDelta(telemetry_.seq, prev_size, x + prev_size, y + prev_size, appended);
+    }
+  } else if (binary) {
+    control_message_.WriteBinary(x, y, size);
+  } else {
+    control_message_.Write(x, y, size);
+  }
+}
@@ -0,0 +1,106 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <ostream>
+#include <string>
+
+#include "control_message.h"
+#include "frame_arena.h"
+#include "highway_map.h"
+#include "reference_line.h"
+#include "telemetry.h"
+#include "tiled_map.h"
+
+// map data every planner reads, loaded once at startup
+struct PlannerMap
+{
+  PlannerMap() : use_tiles(false) {}
+
+  // the tiled map if tiles_file exists, else the binary map with the csv map as
+  // fallback. reports what was loaded on log, false if nothing could be.
+  bool Load(const std::string &tiles_file, const std::string &bin_file, const std::string &csv_file, double max_s,
+            std::ostream &log);
+
+  // waypoints with their derived per-segment data and spatial index, read-only after loading
+  HighwayMap map;
+  // dense reference line for constant time Frenet to Cartesian conversion
+  ReferenceLine ref_line;
+  // tiles of a long route, prefetched around the car in the background
+  TiledMap tiled_map;
+  bool use_tiles;
+};
+
+// the path planner for one simulator connection. takes the raw websocket
+// frames and answers them, without knowing about the network, so the server,
+// the replay tool and offline runs all drive the same planning code.
+class Planner
+{
+public:
+  explicit Planner(PlannerMap &map);
+
+  // handle one websocket frame, binary for the frames of binary_frame.h. true
+  // if there is a reply to send, in the same protocol, which stays valid until
+  // the next call.
+  bool OnMessage(const char *data, size_t length, bool binary, const char *&reply, size_t &reply_length);
+
+  // where the planner reports its decisions, std::cout by default
+  void set_log(std::ostream *log) { log_ = log; }
+
+  // time a frame may take from the start of OnMessage, 0 for no limit. the
+  // lane change candidates are evaluated in order of priority while there is
+  // time left, checked before every lane and between the cars in it. the path
+  // in the current lane is always planned.
+  void set_deadline_us(double deadline_us) { deadline_us_ = deadline_us; }
+
+  // frames planned, and those of them where the deadline cut the evaluation short
+  uint64_t plans() const { return plans_; }
+  uint64_t truncated_plans() const { return truncated_plans_; }
+  // whether the deadline cut the last frame short
+  bool truncated() const { return truncated_; }
+
+private:
+  // plan the next path from telemetry_ into control_message_, as binary or text frame
+  void Plan(bool binary);
+
+  // write the path of size points, of which the first prev_size are the
+  // previous path, into control_message_
+  void WriteControl(bool binary, const double *x, const double *y, int size, int prev_size);
+
+  bool DeadlinePassed() const
+  {
+    return deadline_us_ > 0 && std::chrono::steady_clock::now() >= deadline_;
+  }
+
+  PlannerMap &map_;
+
+  // decoded telemetry, one instance reused for every frame
+  Telemetry telemetry_;
+
+  // the control frame sent back, its buffer is reused for every tick
+  ControlMessage control_message_;
+
+  // the temporaries of planning one frame, reset after every message
+  FrameArena arena_;
+
+  // car starts in middle lane
+  int lane_;
+
+  // variable for lc_alg
+  bool lc_alg_;
+
+  // reference velocity to target (start with 0 mph)
+  double ref_vel_; // in mph
+
+  std::ostream *log_;
+
+  double deadline_us_;
+  std::chrono::steady_clock::time_point deadline_;
+  bool truncated_;
+  uint64_t plans_;
+  uint64_t truncated_plans_;
+};
+
+#endif // PLANNER_H
@@ -0,0 +1,121 @@
+#include "reference_line.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+ReferenceLine::ReferenceLine()
+  : step_(0), inv_step_(0), max_s_(0), intervals_(0)
+{
+}
+
+void ReferenceLine::Build(const HighwayMap &map, double step)
+{
+  int n = map.size();
+  double max_s = map.max_s();
+  const double *map_x = map.x();
+  const double *map_y = map.y();
+  const double *map_s = map.s();
+  const double *map_dx = map.dx();
+  const double *map_dy = map.dy();
+
+  step_ = step;
+  inv_step_ = 1. / step;
+  max_s_ = max_s;
+  intervals_ = (int)ceil(max_s / step);
+
+  x_.resize(intervals_ + 1);
+  y_.resize(intervals_ + 1);
+  nx_.resize(intervals_ + 1);
+  ny_.resize(intervals_ + 1);
+
+  int prev_wp = map.PrevWaypoint(0);
+
+  for(int i = 0; i <= intervals_; i++)
+  {
+    double s = map.WrapS(i * step);
+
+    // samples come in increasing s, so the segment only ever moves forward
+    while(!map.SegmentContains(prev_wp, s))
+    {
+      prev_wp = (prev_wp + 1) % n;
+    }
+    int next_wp = (prev_wp + 1) % n;
+
+    // position on the segment, the closing segment continues past max_s
+    double seg_s = s - map_s[prev_wp];
+    if(seg_s < 0)
+    {
+      seg_s += max_s;
+    }
+
+    x_[i] = map_x[prev_wp] + seg_s * map.tangent_x()[prev_wp];
+    y_[i] = map_y[prev_wp] + seg_s * map.tangent_y()[prev_wp];
+
+    // blend the waypoint normals by the fraction of the segment travelled
+    double seg_ds = map_s[next_wp] - map_s[prev_wp];
+    if(seg_ds <= 0)
+    {
+      seg_ds += max_s;
+    }
+    double t = min(seg_s / seg_ds, 1.);
+
+    double nx = map_dx[prev_wp] + t * (map_dx[next_wp] - map_dx[prev_wp]);
+    double ny = map_dy[prev_wp] + t * (map_dy[next_wp] - map_dy[prev_wp]);
+    double norm = sqrt(nx*nx + ny*ny);
+
+    nx_[i] = nx / norm;
+    ny_[i] = ny / norm;
+  }
+}
+
+void ReferenceLine::getXY(double s, double d, double &x, double &y) const
+{
+  // wrap s around the track
+  s -= floor(s / max_s_) * max_s_;
+
+  double f = s * inv_step_;
+  int i = min((int)f, intervals_ - 1);
+  double t = f - i;
+
+  double cx = x_[i] + t * (x_[i+1] - x_[i]);
+  double cy = y_[i] + t * (y_[i+1] - y_[i]);
+  double nx = nx_[i] + t * (nx_[i+1] - nx_[i]);
+  double ny = ny_[i] + t * (ny_[i+1] - ny_[i]);
+
+  x = cx + d * nx;
+  y = cy + d * ny;
+}
+
+// body of getXYBatch. the pointers are restrict qualified parameters, which is
+// what lets the compiler vectorize the loop with gathers from the table.
+static void InterpolateBatch(const double *__restrict s, const double *__restrict d,
+                             double *__restrict x, double *__restrict y, size_t n,
+                             const double *__restrict line_x, const double *__restrict line_y,
+                             const double *__restrict line_nx, const double *__restrict line_ny,
+                             double max_s, double inv_step, int last_interval)
+{
+  for(size_t k = 0; k < n; k++)
+  {
+    double sk = s[k] - floor(s[k] / max_s) * max_s;
+
+    double f = sk * inv_step;
+    int i = min((int)f, last_interval);
+    double t = f - i;
+
+    double cx = line_x[i] + t * (line_x[i+1] - line_x[i]);
+    double cy = line_y[i] + t * (line_y[i+1] - line_y[i]);
+    double nx = line_nx[i] + t * (line_nx[i+1] - line_nx[i]);
+    double ny = line_ny[i] + t * (line_ny[i+1] - line_ny[i]);
+
+    x[k] = cx + d[k] * nx;
+    y[k] = cy + d[k] * ny;
+  }
+}
+
+void ReferenceLine::getXYBatch(const double *s, const double *d, double *x, double *y, size_t n) const
+{
+  InterpolateBatch(s, d, x, y, n, x_.data(), y_.data(), nx_.data(), ny_.data(),
+                   max_s_, inv_step_, intervals_ - 1);
+}
@@ -0,0 +1,47 @@
+#ifndef REFERENCE_LINE_H
+#define REFERENCE_LINE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "highway_map.h"
+
+// densely sampled reference line of the track for constant time Frenet to
+// Cartesian conversion. the road center and its unit normal (the dx,dy of the
+// map, pointing outward) are sampled every step meters of s at load time, so a
+// lookup is an index computation plus one linear interpolation.
+class ReferenceLine
+{
+public:
+  ReferenceLine();
+
+  // sample the waypoint polyline and the interpolated waypoint normals
+  void Build(const HighwayMap &map, double step = 0.5);
+
+  // transform from Frenet s,d coordinates to Cartesian x,y
+  void getXY(double s, double d, double &x, double &y) const;
+
+  // batch transform of n points from s[],d[] into the caller's x[],y[] buffers.
+  // same arithmetic as getXY, written without branches so it vectorizes.
+  void getXYBatch(const double *s, const double *d, double *x, double *y, size_t n) const;
+
+  double step() const { return step_; }
+
+  // number of sampled points and the memory they take
+  size_t size() const { return x_.size(); }
+  size_t bytes() const { return 4 * x_.capacity() * sizeof(double); }
+
+private:
+  double step_;
+  double inv_step_;
+  double max_s_;
+  int intervals_;
+
+  // road center and unit normal at s = i*step, the last sample closes the loop
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> nx_;
+  std::vector<double> ny_;
+};
+
+#endif // REFERENCE_LINE_H
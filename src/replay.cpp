@@ -0,0 +1,347 @@
+// replays a frame log recorded by path_planning --record through the same
+// Planner the server runs, one planner per recorded connection, and reports
+// per-frame latency percentiles, throughput and the heap allocations made
+// while planning. the checksum covers every reply, so two builds that plan the
+// same paths print the same checksum.
+//
+// usage: replay [--realtime] [--verbose] [--loops N] [--check-allocs N] [--deadline-us N] [--isolation N]
+//               <frames.log>
+//
+// by default frames are fed as fast as the planner takes them. --realtime
+// keeps the recorded spacing between frames, --verbose prints the planner's
+// log and --loops replays the log N times with fresh planners every time.
+// --check-allocs fails the replay if a planner allocates from the heap after
+// its first N frames, the planner is meant to run allocation free once warm.
+// --deadline-us gives every frame that many microseconds and reports how many
+// plans the deadline cut short, see Planner::set_deadline_us.
+// --isolation checks that sessions don't share planner state: the recorded
+// connections are spread over N sessions, each starting at a different frame
+// of its connection, and planned interleaved frame by frame. every session's
+// replies must hash the same as when it is planned alone.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_log.h"
+#include "planner.h"
+#include "tool_common.h"
+
+using namespace std;
+
+// heap allocations of the calling thread. the tile prefetch thread allocates
+// on its own, that is not the telemetry to control path and isn't counted.
+static thread_local uint64_t allocations = 0;
+
+#ifdef __GLIBC__
+// C allocations are counted too, those of stdio and the C library among them
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+  allocations++;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+  allocations++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  allocations++;
+  return __libc_realloc(ptr, size);
+}
+
+#define HeapAllocate __libc_malloc
+#else
+#define HeapAllocate malloc
+#endif
+
+void *operator new(size_t size)
+{
+  allocations++;
+  void *ptr = HeapAllocate(size ? size : 1);
+  if (ptr == NULL) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+// out of line, or the compiler sees free() take a pointer from operator new
+// wherever a delete is inlined and warns about the mismatch
+static __attribute__((noinline)) void HeapFree(void *ptr)
+{
+  free(ptr);
+}
+
+// plain and sized delete, a C++14 compiler calls the sized one
+void operator delete(void *ptr) noexcept
+{
+  HeapFree(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  HeapFree(ptr);
+}
+
+// one session of --isolation: a recorded connection from frame first on
+struct IsolationSession
+{
+  const vector<pair<FrameLogRecord, const char *> > *frames;
+  size_t first;
+  uint64_t checksum;
+};
+
+// plan frame number frame of session with planner and hash the reply
+static void PlanFrame(Planner &planner, IsolationSession &session, size_t frame)
+{
+  const pair<FrameLogRecord, const char *> &entry = (*session.frames)[session.first + frame];
+  const char *reply;
+  size_t reply_length;
+  if (planner.OnMessage(entry.second, entry.first.length, entry.first.opcode == kFrameBinary, reply, reply_length)) {
+    session.checksum = Fnv1a(session.checksum, reply, reply_length);
+  }
+}
+
+// --isolation: false if a session planned among the others replies
+// differently from the same session planned alone
+static bool CheckIsolation(FrameLog &frame_log, PlannerMap &planner_map, ostream &log, int num_sessions)
+{
+  map<uint32_t, vector<pair<FrameLogRecord, const char *> > > connections;
+  FrameLogRecord record;
+  const char *data;
+  frame_log.Rewind();
+  while (frame_log.Next(record, data)) {
+    connections[record.connection].push_back(make_pair(record, data));
+  }
+  if (connections.empty()) {
+    std::cerr << "no frames to check" << std::endl;
+    return false;
+  }
+
+  // copies of a connection start ever later in it
+  vector<IsolationSession> sessions(num_sessions);
+  size_t longest = 0;
+  auto connection = connections.begin();
+  for (int i = 0; i < num_sessions; i++) {
+    IsolationSession &session = sessions[i];
+    session.frames = &connection->second;
+    session.first = (i / connections.size()) % connection->second.size();
+    session.checksum = kFnv1aBasis;
+    longest = max(longest, session.frames->size() - session.first);
+    if (++connection == connections.end()) {
+      connection = connections.begin();
+    }
+  }
+
+  // every session takes its next frame in turn
+  vector<unique_ptr<Planner> > planners;
+  for (int i = 0; i < num_sessions; i++) {
+    planners.push_back(unique_ptr<Planner>(new Planner(planner_map)));
+    planners.back()->set_log(&log);
+  }
+  uint64_t frames = 0;
+  for (size_t frame = 0; frame < longest; frame++) {
+    for (int i = 0; i < num_sessions; i++) {
+      if (sessions[i].first + frame < sessions[i].frames->size()) {
+        PlanFrame(*planners[i], sessions[i], frame);
+        frames++;
+      }
+    }
+  }
+  planners.clear();
+
+  for (int i = 0; i < num_sessions; i++) {
+    IsolationSession alone = sessions[i];
+    alone.checksum = kFnv1aBasis;
+    Planner planner(planner_map);
+    planner.set_log(&log);
+    for (size_t frame = 0; alone.first + frame < alone.frames->size(); frame++) {
+      PlanFrame(planner, alone, frame);
+    }
+    if (alone.checksum != sessions[i].checksum) {
+      printf("FAILED: session %d replied %016llx among the others and %016llx alone\n", i,
+             (unsigned long long)sessions[i].checksum, (unsigned long long)alone.checksum);
+      return false;
+    }
+  }
+
+  printf("isolation: %d sessions from %zu connections, %llu frames interleaved, every session replies as alone\n",
+         num_sessions, connections.size(), (unsigned long long)frames);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool realtime = false;
+  bool verbose = false;
+  int loops = 1;
+  // frames a planner may allocate in, the rest are expected not to
+  int warm_up = 1;
+  bool check_allocs = false;
+  double deadline_us = 0;
+  int isolation = 0;
+
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; arg++) {
+    if (strcmp(argv[arg], "--realtime") == 0) {
+      realtime = true;
+    } else if (strcmp(argv[arg], "--verbose") == 0) {
+      verbose = true;
+    } else if (strcmp(argv[arg], "--loops") == 0 && arg + 1 < argc) {
+      loops = atoi(argv[++arg]);
+    } else if (strcmp(argv[arg], "--check-allocs") == 0 && arg + 1 < argc) {
+      warm_up = atoi(argv[++arg]);
+      check_allocs = true;
+    } else if (strcmp(argv[arg], "--deadline-us") == 0 && arg + 1 < argc) {
+      deadline_us = atof(argv[++arg]);
+    } else if (strcmp(argv[arg], "--isolation") == 0 && arg + 1 < argc) {
+      isolation = atoi(argv[++arg]);
+    } else {
+      break;
+    }
+  }
+
+  if (arg != argc - 1 || loops < 1 || warm_up < 0 || deadline_us < 0 || isolation < 0) {
+    std::cerr << "usage: replay [--realtime] [--verbose] [--loops N] [--check-allocs N] [--deadline-us N] [--isolation N]"
+              << " <frames.log>" << std::endl;
+    return 1;
+  }
+
+  FrameLog frame_log;
+  if (!frame_log.Open(argv[arg])) {
+    std::cerr << frame_log.error() << std::endl;
+    return 1;
+  }
+
+  // the same map the server loads
+  PlannerMap planner_map;
+  if (!planner_map.Load(kMapTilesFile, kMapBinFile, kMapCsvFile, kMapMaxS,
+                        std::cout)) {
+    return 1;
+  }
+
+  // planner decisions are only printed with --verbose
+  ostream null_log(NULL);
+
+  if (isolation > 0) {
+    return CheckIsolation(frame_log, planner_map, verbose ? std::cout : null_log, isolation) ? 0 : 1;
+  }
+
+  vector<double> latencies_us;
+  uint64_t checksum = kFnv1aBasis;
+  uint64_t replies = 0;
+  double busy_s = 0;
+  // allocations inside OnMessage, and in the frames after a planner's warm-up
+  uint64_t planning_allocations = 0;
+  uint64_t warm_allocations = 0;
+  // the first warm frame that allocated
+  uint32_t failed_connection = 0;
+  uint64_t failed_frame = 0;
+  uint64_t failed_allocations = 0;
+  // plans made, and those the deadline truncated
+  uint64_t plans = 0;
+  uint64_t truncated_plans = 0;
+
+  auto replay_start = chrono::steady_clock::now();
+
+  for (int loop = 0; loop < loops; loop++) {
+    map<uint32_t, Planner *> planners;
+    map<uint32_t, uint64_t> planned;
+
+    auto loop_start = chrono::steady_clock::now();
+
+    FrameLogRecord record;
+    const char *data;
+    frame_log.Rewind();
+    while (frame_log.Next(record, data)) {
+      if (realtime) {
+        this_thread::sleep_until(loop_start + chrono::nanoseconds(record.timestamp_ns));
+      }
+
+      Planner *&planner = planners[record.connection];
+      uint64_t &frame = planned[record.connection];
+      if (planner == NULL) {
+        planner = new Planner(planner_map);
+        planner->set_log(verbose ? &std::cout : &null_log);
+        planner->set_deadline_us(deadline_us);
+      }
+
+      const char *reply;
+      size_t reply_length;
+
+      uint64_t start_allocations = allocations;
+      auto start = chrono::steady_clock::now();
+      bool has_reply = planner->OnMessage(data, record.length, record.opcode == kFrameBinary, reply,
+                                                reply_length);
+      double frame_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      uint64_t frame_allocations = allocations - start_allocations;
+      planning_allocations += frame_allocations;
+      if (frame >= (uint64_t)warm_up && frame_allocations > 0) {
+        if (warm_allocations == 0) {
+          failed_connection = record.connection;
+          failed_frame = frame;
+          failed_allocations = frame_allocations;
+        }
+        warm_allocations += frame_allocations;
+      }
+      frame++;
+
+      busy_s += frame_s;
+      latencies_us.push_back(frame_s * 1e6);
+      if (has_reply) {
+        checksum = Fnv1a(checksum, reply, reply_length);
+        replies++;
+      }
+    }
+
+    for (auto &entry : planners) {
+      plans += entry.second->plans();
+      truncated_plans += entry.second->truncated_plans();
+      delete entry.second;
+    }
+  }
+
+  double wall_s = chrono::duration<double>(chrono::steady_clock::now() - replay_start).count();
+
+  sort(latencies_us.begin(), latencies_us.end());
+
+  size_t frames = latencies_us.size();
+  std::cout << "frames " << frames << ", replies " << replies << ", " << loops << " loop(s) in " << wall_s << " s" << std::endl;
+  std::cout << "throughput " << (busy_s > 0 ? frames / busy_s : 0) << " frames/s planning, ";
+  std::cout << (wall_s > 0 ? frames / wall_s : 0) << " frames/s wall clock" << std::endl;
+  printf("latency us: p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n", Percentile(latencies_us, 50),
+         Percentile(latencies_us, 90), Percentile(latencies_us, 99), Percentile(latencies_us, 99.9),
+         frames ? latencies_us.back() : 0.0);
+  printf("heap allocations while planning: %llu, %llu after the first %d frame(s) of each planner\n",
+         (unsigned long long)planning_allocations, (unsigned long long)warm_allocations, warm_up);
+  if (deadline_us > 0) {
+    printf("deadline %.2f us truncated %llu of %llu plans (%.2f%%)\n", deadline_us, (unsigned long long)truncated_plans,
+           (unsigned long long)plans, plans ? 100.0 * truncated_plans / plans : 0.0);
+  }
+  printf("checksum %016llx\n", (unsigned long long)checksum);
+
+  if (check_allocs && warm_allocations > 0) {
+    printf("FAILED: frame %llu of connection %u made %llu heap allocation(s)\n", (unsigned long long)failed_frame,
+           failed_connection, (unsigned long long)failed_allocations);
+    return 1;
+  }
+
+  return 0;
+}
@@ -31,6 +31,7 @@
 #include <cassert>
 #include <vector>
 #include <algorithm>
+#include <memory>
 
 
 // unnamed namespace only because the implementation is in this
@@ -41,25 +42,36 @@ namespace
 namespace tk
 {
 
-// band matrix solver
+// band matrix solver. the bands are kept in vectors of the given allocator,
+// each band is dim() consecutive entries of one vector, so a matrix is two
+// allocations and resizing it to the same size again is none.
+template<class Alloc = std::allocator<double> >
 class band_matrix
 {
+public:
+    typedef std::vector<double, Alloc> vector_type;
 private:
-    std::vector< std::vector<double> > m_upper;  // upper band
-    std::vector< std::vector<double> > m_lower;  // lower band
+    vector_type m_upper;  // upper band
+    vector_type m_lower;  // lower band
+    int m_dim;
 public:
-    band_matrix() {};                             // constructor
-    band_matrix(int dim, int n_u, int n_l);       // constructor
+    explicit band_matrix(const Alloc& alloc = Alloc())       // constructor
+        : m_upper(alloc), m_lower(alloc), m_dim(0) {};
+    band_matrix(int dim, int n_u, int n_l,
+                const Alloc& alloc = Alloc());               // constructor
     ~band_matrix() {};                            // destructor
     void resize(int dim, int n_u, int n_l);      // init with dim,n_u,n_l
-    int dim() const;                             // matrix dimension
+    int dim() const                              // matrix dimension
+    {
+        return m_dim;
+    }
     int num_upper() const
     {
-        return m_upper.size()-1;
+        return m_dim>0 ? (int)m_upper.size()/m_dim-1 : -1;
     }
     int num_lower() const
     {
-        return m_lower.size()-1;
+        return m_dim>0 ? (int)m_lower.size()/m_dim-1 : -1;
     }
     // access operator
     double & operator () (int i, int j);            // write
@@ -68,28 +80,32 @@ public:
     double& saved_diag(int i);
     double  saved_diag(int i) const;
     void lu_decompose();
-    std::vector<double> r_solve(const std::vector<double>& b) const;
-    std::vector<double> l_solve(const std::vector<double>& b) const;
-    std::vector<double> lu_solve(const std::vector<double>& b,
-                                 bool is_lu_decomposed=false);
+    // the solvers overwrite b with the solution x
+    void r_solve(vector_type& b) const;
+    void l_solve(vector_type& b) const;
+    void lu_solve(vector_type& b, bool is_lu_decomposed=false);
 
 };
 
 
-// spline interpolation
-class spline
+// spline interpolation, the points and coefficients are kept in vectors of
+// the given allocator
+template<class Alloc = std::allocator<double> >
+class basic_spline
 {
 public:
     enum bd_type {
         first_deriv = 1,
         second_deriv = 2
     };
+    typedef std::vector<double, Alloc> vector_type;
 
 private:
-    std::vector<double> m_x,m_y;            // x,y coordinates of points
+    vector_type m_x,m_y;            // x,y coordinates of points
     // interpolation parameters
     // f(x) = a*(x-x_i)^3 + b*(x-x_i)^2 + c*(x-x_i) + y_i
-    std::vector<double> m_a,m_b,m_c;        // spline coefficients
+    vector_type m_a,m_b,m_c;        // spline coefficients
+    band_matrix<Alloc> m_A;         // equation system of the coefficients
     double  m_b0, m_c0;                     // for left extrapol
     bd_type m_left, m_right;
     double  m_left_value, m_right_value;
@@ -97,7 +113,9 @@ private:
 
 public:
     // set default boundary condition to be zero curvature at both ends
-    spline(): m_left(second_deriv), m_right(second_deriv),
+    explicit basic_spline(const Alloc& alloc = Alloc()):
+        m_x(alloc), m_y(alloc), m_a(alloc), m_b(alloc), m_c(alloc), m_A(alloc),
+        m_left(second_deriv), m_right(second_deriv),
         m_left_value(0.0), m_right_value(0.0),
         m_force_linear_extrapolation(false)
     {
@@ -108,11 +126,14 @@ public:
     void set_boundary(bd_type left, double left_value,
                       bd_type right, double right_value,
                       bool force_linear_extrapolation=false);
-    void set_points(const std::vector<double>& x,
-                    const std::vector<double>& y, bool cubic_spline=true);
+    // x and y are any random access containers of double
+    template<class Vector>
+    void set_points(const Vector& x, const Vector& y, bool cubic_spline=true);
     double operator() (double x) const;
 };
 
+typedef basic_spline<> spline;
+
 
 
 // ---------------------------------------------------------------------
@@ -123,68 +144,63 @@ public:
 // band_matrix implementation
 // -------------------------
 
-band_matrix::band_matrix(int dim, int n_u, int n_l)
+template<class Alloc>
+band_matrix<Alloc>::band_matrix(int dim, int n_u, int n_l, const Alloc& alloc)
+    : m_upper(alloc), m_lower(alloc), m_dim(0)
 {
     resize(dim, n_u, n_l);
 }
-void band_matrix::resize(int dim, int n_u, int n_l)
+template<class Alloc>
+void band_matrix<Alloc>::resize(int dim, int n_u, int n_l)
 {
     assert(dim>0);
     assert(n_u>=0);
     assert(n_l>=0);
-    m_upper.resize(n_u+1);
-    m_lower.resize(n_l+1);
-    for(size_t i=0; i<m_upper.size(); i++) {
-        m_upper[i].resize(dim);
-    }
-    for(size_t i=0; i<m_lower.size(); i++) {
-        m_lower[i].resize(dim);
-    }
-}
-int band_matrix::dim() const
-{
-    if(m_upper.size()>0) {
-        return m_upper[0].size();
-    } else {
-        return 0;
-    }
+    m_dim=dim;
+    m_upper.assign((n_u+1)*dim, 0.0);
+    m_lower.assign((n_l+1)*dim, 0.0);
 }
 
 
 // defines the new operator (), so that we can access the elements
 // by A(i,j), index going from i=0,...,dim()-1
-double & band_matrix::operator () (int i, int j)
+template<class Alloc>
+double & band_matrix<Alloc>::operator () (int i, int j)
 {
     int k=j-i;       // what band is the entry
     assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
     assert( (-num_lower()<=k) && (k<=num_upper()) );
     // k=0 -> diogonal, k<0 lower left part, k>0 upper right part
-    if(k>=0)   return m_upper[k][i];
-    else	    return m_lower[-k][i];
+    if(k>=0)   return m_upper[k*m_dim+i];
+    else	    return m_lower[-k*m_dim+i];
 }
-double band_matrix::operator () (int i, int j) const
+template<class Alloc>
+double band_matrix<Alloc>::operator () (int i, int j) const
 {
     int k=j-i;       // what band is the entry
     assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
     assert( (-num_lower()<=k) && (k<=num_upper()) );
     // k=0 -> diogonal, k<0 lower left part, k>0 upper right part
-    if(k>=0)   return m_upper[k][i];
-    else	    return m_lower[-k][i];
+    if(k>=0)   return m_upper[k*m_dim+i];
+    else	    return m_lower[-k*m_dim+i];
 }
 // second diag (used in LU decomposition), saved in m_lower
-double band_matrix::saved_diag(int i) const
+template<class Alloc>
+double band_matrix<Alloc>::saved_diag(int i) const
 {
     assert( (i>=0) && (i<dim()) );
-    return m_lower[0][i];
+    return m_lower[i];
 }
-double & band_matrix::saved_diag(int i)
+template<class Alloc>
+double & band_matrix<Alloc>::saved_diag(int i)
 {
     assert( (i>=0) && (i<dim()) );
-    return m_lower[0][i];
+    return m_lower[i];
 }
 
 // LR-Decomposition of a band matrix
-void band_matrix::lu_decompose()
+template<class Alloc>
+void band_matrix<Alloc>::lu_decompose()
 {
     int  i_max,j_max;
     int  j_min;
@@ -218,11 +234,12 @@ void band_matrix::lu_decompose()
         }
     }
 }
-// solves Ly=b
-std::vector<double> band_matrix::l_solve(const std::vector<double>& b) const
+// solves Ly=b, in place: x[i] only needs b[i] and the x[j<i] before it
+template<class Alloc>
+void band_matrix<Alloc>::l_solve(vector_type& b) const
 {
     assert( this->dim()==(int)b.size() );
-    std::vector<double> x(this->dim());
+    vector_type& x=b;
     int j_start;
     double sum;
     for(int i=0; i<this->dim(); i++) {
@@ -231,13 +248,13 @@ std::vector<double> band_matrix::l_solve(const std::vector<double>& b) const
         for(int j=j_start; j<i; j++) sum += this->operator()(i,j)*x[j];
         x[i]=(b[i]*this->saved_diag(i)) - sum;
     }
-    return x;
 }
-// solves Rx=y
-std::vector<double> band_matrix::r_solve(const std::vector<double>& b) const
+// solves Rx=y, in place: x[i] only needs b[i] and the x[j>i] before it
+template<class Alloc>
+void band_matrix<Alloc>::r_solve(vector_type& b) const
 {
     assert( this->dim()==(int)b.size() );
-    std::vector<double> x(this->dim());
+    vector_type& x=b;
     int j_stop;
     double sum;
     for(int i=this->dim()-1; i>=0; i--) {
@@ -246,20 +263,17 @@ std::vector<double> band_matrix::r_solve(const std::vector<double>& b) const
         for(int j=i+1; j<=j_stop; j++) sum += this->operator()(i,j)*x[j];
         x[i]=( b[i] - sum ) / this->operator()(i,i);
     }
-    return x;
 }
 
-std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
-        bool is_lu_decomposed)
+template<class Alloc>
+void band_matrix<Alloc>::lu_solve(vector_type& b, bool is_lu_decomposed)
 {
     assert( this->dim()==(int)b.size() );
-    std::vector<double>  x,y;
     if(is_lu_decomposed==false) {
         this->lu_decompose();
     }
-    y=this->l_solve(b);
-    x=this->r_solve(y);
-    return x;
+    this->l_solve(b);
+    this->r_solve(b);
 }
 
 
@@ -268,9 +282,10 @@ std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
 // spline implementation
 // -----------------------
 
-void spline::set_boundary(spline::bd_type left, double left_value,
-                          spline::bd_type right, double right_value,
-                          bool force_linear_extrapolation)
+template<class Alloc>
+void basic_spline<Alloc>::set_boundary(bd_type left, double left_value,
+                                       bd_type right, double right_value,
+                                       bool force_linear_extrapolation)
 {
     assert(m_x.size()==0);          // set_points() must not have happened yet
     m_left=left;
@@ -281,13 +296,14 @@ void spline::set_boundary(spline::bd_type left, double left_value,
 }
 
 
-void spline::set_points(const std::vector<double>& x,
-                        const std::vector<double>& y, bool cubic_spline)
+template<class Alloc>
+template<class Vector>
+void basic_spline<Alloc>::set_points(const Vector& x, const Vector& y, bool cubic_spline)
 {
     assert(x.size()==y.size());
     assert(x.size()>2);
-    m_x=x;
-    m_y=y;
+    m_x.assign(x.begin(), x.end());
+    m_y.assign(y.begin(), y.end());
     int   n=x.size();
     // TODO: maybe sort x and y, rather than returning an error
     for(int i=0; i<n-1; i++) {
@@ -296,9 +312,11 @@ void spline::set_points(const std::vector<double>& x,
 
     if(cubic_spline==true) { // cubic spline interpolation
         // setting up the matrix and right hand side of the equation system
-        // for the parameters b[]
-        band_matrix A(n,1,1);
-        std::vector<double>  rhs(n);
+        // for the parameters b[], which is solved in place in m_b
+        band_matrix<Alloc>& A=m_A;
+        A.resize(n,1,1);
+        vector_type& rhs=m_b;
+        rhs.assign(n, 0.0);
         for(int i=1; i<n-1; i++) {
             A(i,i-1)=1.0/3.0*(x[i]-x[i-1]);
             A(i,i)=2.0/3.0*(x[i+1]-x[i-1]);
@@ -306,12 +324,12 @@ void spline::set_points(const std::vector<double>& x,
             rhs[i]=(y[i+1]-y[i])/(x[i+1]-x[i]) - (y[i]-y[i-1])/(x[i]-x[i-1]);
         }
         // boundary conditions
-        if(m_left == spline::second_deriv) {
+        if(m_left == second_deriv) {
             // 2*b[0] = f''
             A(0,0)=2.0;
             A(0,1)=0.0;
             rhs[0]=m_left_value;
-        } else if(m_left == spline::first_deriv) {
+        } else if(m_left == first_deriv) {
             // c[0] = f', needs to be re-expressed in terms of b:
             // (2b[0]+b[1])(x[1]-x[0]) = 3 ((y[1]-y[0])/(x[1]-x[0]) - f')
             A(0,0)=2.0*(x[1]-x[0]);
@@ -320,12 +338,12 @@ void spline::set_points(const std::vector<double>& x,
         } else {
             assert(false);
         }
-        if(m_right == spline::second_deriv) {
+        if(m_right == second_deriv) {
             // 2*b[n-1] = f''
             A(n-1,n-1)=2.0;
             A(n-1,n-2)=0.0;
             rhs[n-1]=m_right_value;
-        } else if(m_right == spline::first_deriv) {
+        } else if(m_right == first_deriv) {
             // c[n-1] = f', needs to be re-expressed in terms of b:
             // (b[n-2]+2b[n-1])(x[n-1]-x[n-2])
             // = 3 (f' - (y[n-1]-y[n-2])/(x[n-1]-x[n-2]))
@@ -337,7 +355,7 @@ void spline::set_points(const std::vector<double>& x,
         }
 
         // solve the equation system to obtain the parameters b[]
-        m_b=A.lu_solve(rhs);
+        A.lu_solve(rhs);
 
         // calculate parameters a[] and c[] based on b[]
         m_a.resize(n);
@@ -372,11 +390,12 @@ void spline::set_points(const std::vector<double>& x,
         m_b[n-1]=0.0;
 }
 
-double spline::operator() (double x) const
+template<class Alloc>
+double basic_spline<Alloc>::operator() (double x) const
 {
     size_t n=m_x.size();
     // find the closest point m_x[idx] < x, idx=0 even if x<m_x[0]
-    std::vector<double>::const_iterator it;
+    typename vector_type::const_iterator it;
     it=std::lower_bound(m_x.begin(),m_x.end(),x);
     int idx=std::max( int(it-m_x.begin())-1, 0);
 
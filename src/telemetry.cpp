@@ -0,0 +1,374 @@
+#include "telemetry.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "binary_frame.h"
+#include "json_sax.h"
+
+static bool Equals(const char *str, size_t len, const char *literal)
+{
+  return strlen(literal) == len && memcmp(str, literal, len) == 0;
+}
+
+TelemetrySax::TelemetrySax(Telemetry &telemetry)
+  : telemetry_(telemetry), depth_(0), elements_(0), is_telemetry_(false), data_(kDataMissing),
+    field_(kFieldNone), prev_size_y_(0), column_(0)
+{
+  telemetry_.x = telemetry_.y = telemetry_.s = telemetry_.d = 0;
+  telemetry_.yaw = telemetry_.speed = 0;
+  telemetry_.prev_size = 0;
+  telemetry_.end_path_s = telemetry_.end_path_d = 0;
+  telemetry_.num_cars = 0;
+  telemetry_.delta = false;
+  telemetry_.seq = 0;
+}
+
+TelemetryEvent TelemetrySax::event() const
+{
+  // an event without data is what the simulator sends in manual mode
+  if(data_ == kDataMissing || data_ == kDataNull)
+  {
+    return kEventManual;
+  }
+  if(!is_telemetry_)
+  {
+    return kEventOther;
+  }
+
+  // the path is used point by point, both coordinates have to be there
+  if(data_ != kDataObject || prev_size_y_ != telemetry_.prev_size)
+  {
+    return kEventInvalid;
+  }
+
+  return kEventTelemetry;
+}
+
+bool TelemetrySax::InData() const
+{
+  return is_telemetry_ && data_ == kDataObject && elements_ == 2;
+}
+
+bool TelemetrySax::Element(Data data)
+{
+  elements_++;
+
+  // the first element is the event name
+  if(elements_ == 1)
+  {
+    return false;
+  }
+  if(elements_ == 2)
+  {
+    data_ = data;
+  }
+
+  return true;
+}
+
+bool TelemetrySax::Null()
+{
+  return depth_ > 0 && (depth_ > 1 || Element(kDataNull));
+}
+
+bool TelemetrySax::Boolean(bool)
+{
+  return depth_ > 0 && (depth_ > 1 || Element(kDataOther));
+}
+
+bool TelemetrySax::Number(double value)
+{
+  if(depth_ <= 1)
+  {
+    return depth_ == 1 && Element(kDataOther);
+  }
+  if(!InData())
+  {
+    return true;
+  }
+
+  if(depth_ == 2)
+  {
+    switch(field_)
+    {
+    case kFieldX: telemetry_.x = value; break;
+    case kFieldY: telemetry_.y = value; break;
+    case kFieldS: telemetry_.s = value; break;
+    case kFieldD: telemetry_.d = value; break;
+    case kFieldYaw: telemetry_.yaw = value; break;
+    case kFieldSpeed: telemetry_.speed = value; break;
+    case kFieldEndPathS: telemetry_.end_path_s = value; break;
+    case kFieldEndPathD: telemetry_.end_path_d = value; break;
+    case kFieldSeq:
+      telemetry_.delta = true;
+      telemetry_.seq = (value >= 0 && value <= UINT32_MAX) ? (uint32_t)value : 0;
+      break;
+    default: break;
+    }
+  }
+  else if(depth_ == 3 && (field_ == kFieldPreviousPathX || field_ == kFieldPreviousPathY))
+  {
+    bool is_x = (field_ == kFieldPreviousPathX);
+    int &count = is_x ? telemetry_.prev_size : prev_size_y_;
+    if(count == kMaxPathPoints)
+    {
+      return false;
+    }
+    (is_x ? telemetry_.previous_path_x : telemetry_.previous_path_y)[count++] = value;
+  }
+  else if(depth_ == 4 && field_ == kFieldSensorFusion)
+  {
+    // [id, x, y, vx, vy, s, d]
+    SensorFusionRow &row = telemetry_.sensor_fusion[telemetry_.num_cars];
+    switch(column_++)
+    {
+    case 0: row.id = value; break;
+    case 1: row.x = value; break;
+    case 2: row.y = value; break;
+    case 3: row.vx = value; break;
+    case 4: row.vy = value; break;
+    case 5: row.s = value; break;
+    case 6: row.d = value; break;
+    default: return false;
+    }
+  }
+
+  return true;
+}
+
+bool TelemetrySax::String(const char *str, size_t len)
+{
+  if(depth_ != 1)
+  {
+    return depth_ > 1;
+  }
+
+  elements_++;
+  if(elements_ == 1)
+  {
+    is_telemetry_ = Equals(str, len, "telemetry");
+  }
+  else if(elements_ == 2)
+  {
+    data_ = kDataOther;
+  }
+
+  return true;
+}
+
+bool TelemetrySax::StartObject()
+{
+  if(depth_ == 0 || (depth_ == 1 && !Element(kDataObject)))
+  {
+    return false;
+  }
+
+  // a nested object is read past, its numbers go nowhere
+  if(depth_ == 2)
+  {
+    field_ = kFieldNone;
+  }
+  depth_++;
+
+  return true;
+}
+
+bool TelemetrySax::Key(const char *str, size_t len)
+{
+  if(depth_ != 2 || !InData())
+  {
+    return true;
+  }
+
+  if(Equals(str, len, "x")) field_ = kFieldX;
+  else if(Equals(str, len, "y")) field_ = kFieldY;
+  else if(Equals(str, len, "s")) field_ = kFieldS;
+  else if(Equals(str, len, "d")) field_ = kFieldD;
+  else if(Equals(str, len, "yaw")) field_ = kFieldYaw;
+  else if(Equals(str, len, "speed")) field_ = kFieldSpeed;
+  else if(Equals(str, len, "previous_path_x")) field_ = kFieldPreviousPathX;
+  else if(Equals(str, len, "previous_path_y")) field_ = kFieldPreviousPathY;
+  else if(Equals(str, len, "end_path_s")) field_ = kFieldEndPathS;
+  else if(Equals(str, len, "end_path_d")) field_ = kFieldEndPathD;
+  else if(Equals(str, len, "sensor_fusion")) field_ = kFieldSensorFusion;
+  else if(Equals(str, len, "seq")) field_ = kFieldSeq;
+  else field_ = kFieldNone;
+
+  return true;
+}
+
+bool TelemetrySax::EndObject()
+{
+  depth_--;
+
+  return true;
+}
+
+bool TelemetrySax::StartArray()
+{
+  if(depth_ == 0)
+  {
+    // the event array
+    depth_++;
+    return true;
+  }
+  if(depth_ == 1 && !Element(kDataOther))
+  {
+    return false;
+  }
+
+  if(InData() && depth_ == 2)
+  {
+    if(field_ == kFieldPreviousPathX) telemetry_.prev_size = 0;
+    else if(field_ == kFieldPreviousPathY) prev_size_y_ = 0;
+    else if(field_ == kFieldSensorFusion) telemetry_.num_cars = 0;
+  }
+  else if(InData() && depth_ == 3 && field_ == kFieldSensorFusion)
+  {
+    // a sensor fusion row
+    if(telemetry_.num_cars == kMaxSensorFusion)
+    {
+      return false;
+    }
+    column_ = 0;
+  }
+  depth_++;
+
+  return true;
+}
+
+bool TelemetrySax::EndArray()
+{
+  depth_--;
+
+  if(InData() && depth_ == 3 && field_ == kFieldSensorFusion)
+  {
+    if(column_ != 7)
+    {
+      return false;
+    }
+
+    // the planner needs the speed of every car, work it out once here
+    SensorFusionRow &row = telemetry_.sensor_fusion[telemetry_.num_cars];
+    row.speed = sqrt(row.vx*row.vx + row.vy*row.vy);
+    telemetry_.num_cars++;
+  }
+
+  return true;
+}
+
+TelemetryEvent DecodeTelemetry(const char *data, size_t length, Telemetry &telemetry)
+{
+  // "42" at the start of the message means there's a websocket message event.
+  // The 4 signifies a websocket message
+  // The 2 signifies a websocket event
+  if(length <= 2 || data[0] != '4' || data[1] != '2')
+  {
+    return kEventNone;
+  }
+
+  TelemetrySax handler(telemetry);
+  if(!JsonSaxParse(data + 2, length - 2, handler))
+  {
+    return kEventInvalid;
+  }
+
+  return handler.event();
+}
+
+TelemetryEvent DecodeBinaryTelemetry(const char *data, size_t length, Telemetry &telemetry)
+{
+  BinaryTelemetryFrame frame;
+  if(length < sizeof(frame.header))
+  {
+    return kEventNone;
+  }
+  memcpy(&frame.header, data, sizeof(frame.header));
+  if(frame.header.magic != kBinaryFrameMagic || frame.header.type != kBinaryTelemetry)
+  {
+    return kEventNone;
+  }
+  if(frame.header.version != kBinaryFrameVersion || length < sizeof(frame))
+  {
+    return kEventInvalid;
+  }
+  memcpy(&frame, data, sizeof(frame));
+
+  if(frame.prev_size > (uint32_t)kMaxPathPoints || frame.num_cars > (uint32_t)kMaxSensorFusion ||
+     length != sizeof(frame) + (2 * frame.prev_size + kBinarySensorFusionColumns * frame.num_cars) * sizeof(double))
+  {
+    return kEventInvalid;
+  }
+
+  telemetry.x = frame.x;
+  telemetry.y = frame.y;
+  telemetry.s = frame.s;
+  telemetry.d = frame.d;
+  telemetry.yaw = frame.yaw;
+  telemetry.speed = frame.speed;
+  telemetry.end_path_s = frame.end_path_s;
+  telemetry.end_path_d = frame.end_path_d;
+  telemetry.delta = (frame.flags & kBinaryFlagDelta) != 0;
+  telemetry.seq = frame.seq;
+
+  const char *p = data + sizeof(frame);
+  telemetry.prev_size = frame.prev_size;
+  memcpy(telemetry.previous_path_x, p, frame.prev_size * sizeof(double));
+  p += frame.prev_size * sizeof(double);
+  memcpy(telemetry.previous_path_y, p, frame.prev_size * sizeof(double));
+  p += frame.prev_size * sizeof(double);
+
+  // the rows are the first 7 fields of SensorFusionRow
+  telemetry.num_cars = frame.num_cars;
+  for(uint32_t i = 0; i < frame.num_cars; i++)
+  {
+    SensorFusionRow &row = telemetry.sensor_fusion[i];
+    memcpy(&row.id, p, kBinarySensorFusionColumns * sizeof(double));
+    p += kBinarySensorFusionColumns * sizeof(double);
+    row.speed = sqrt(row.vx*row.vx + row.vy*row.vy);
+  }
+
+  return kEventTelemetry;
+}
+
+size_t BinaryTelemetrySize(const Telemetry &telemetry)
+{
+  return sizeof(BinaryTelemetryFrame) +
+    (2 * telemetry.prev_size + kBinarySensorFusionColumns * telemetry.num_cars) * sizeof(double);
+}
+
+size_t EncodeBinaryTelemetry(const Telemetry &telemetry, char *out)
+{
+  BinaryTelemetryFrame frame;
+  frame.header.magic = kBinaryFrameMagic;
+  frame.header.version = kBinaryFrameVersion;
+  frame.header.type = kBinaryTelemetry;
+  frame.x = telemetry.x;
+  frame.y = telemetry.y;
+  frame.s = telemetry.s;
+  frame.d = telemetry.d;
+  frame.yaw = telemetry.yaw;
+  frame.speed = telemetry.speed;
+  frame.end_path_s = telemetry.end_path_s;
+  frame.end_path_d = telemetry.end_path_d;
+  frame.prev_size = telemetry.prev_size;
+  frame.num_cars = telemetry.num_cars;
+  frame.flags = telemetry.delta ? kBinaryFlagDelta : 0;
+  frame.seq = telemetry.seq;
+
+  char *p = out;
+  memcpy(p, &frame, sizeof(frame));
+  p += sizeof(frame);
+  memcpy(p, telemetry.previous_path_x, telemetry.prev_size * sizeof(double));
+  p += telemetry.prev_size * sizeof(double);
+  memcpy(p, telemetry.previous_path_y, telemetry.prev_size * sizeof(double));
+  p += telemetry.prev_size * sizeof(double);
+  for(int i = 0; i < telemetry.num_cars; i++)
+  {
+    memcpy(p, &telemetry.sensor_fusion[i].id, kBinarySensorFusionColumns * sizeof(double));
+    p += kBinarySensorFusionColumns * sizeof(double);
+  }
+
+  return p - out;
+}
@@ -0,0 +1,147 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// capacity of the fixed-size arrays in Telemetry. the simulator sends back what
+// is left of the 50 points of the last path, and a dozen cars on the highway.
+static const int kMaxPathPoints = 256;
+static const int kMaxSensorFusion = 512;
+
+// one sensor fusion row, [id, x, y, vx, vy, s, d] in the message
+struct SensorFusionRow
+{
+  double id;
+  double x;
+  double y;
+  double vx;
+  double vy;
+  double s;
+  double d;
+
+  // sqrt(vx*vx + vy*vy), computed once while decoding
+  double speed;
+};
+
+// the data object of a telemetry message, decoded in place. the layout is
+// fixed, so one instance is reused for every frame without allocations.
+struct Telemetry
+{
+  // main car's localization data
+  double x;
+  double y;
+  double s;
+  double d;
+  double yaw;
+  double speed;
+
+  // previous path data given to the planner
+  int prev_size;
+  double previous_path_x[kMaxPathPoints];
+  double previous_path_y[kMaxPathPoints];
+
+  // previous path's end s and d values
+  double end_path_s;
+  double end_path_d;
+
+  // a list of all other cars on the same side of the road
+  int num_cars;
+  SensorFusionRow sensor_fusion[kMaxSensorFusion];
+
+  // our own clients send a "seq" number to ask for delta control frames,
+  // which only carry the points appended to the previous path
+  bool delta;
+  uint32_t seq;
+};
+
+enum TelemetryEvent
+{
+  kEventNone,           // not a socket.io event
+  kEventInvalid,        // malformed, or more points or cars than fit
+  kEventManual,         // an event without data, the simulator is in manual mode
+  kEventTelemetry,      // a telemetry event, decoded into the Telemetry
+  kEventOther           // any other event
+};
+
+// JsonSaxParse handler for the ["event", data] array of a socket.io event.
+// fills the ego state, the previous path and the sensor fusion rows of a
+// telemetry event straight into the preallocated arrays of the Telemetry.
+class TelemetrySax
+{
+public:
+  explicit TelemetrySax(Telemetry &telemetry);
+
+  // the kind of event, once the parse is done
+  TelemetryEvent event() const;
+
+  bool Null();
+  bool Boolean(bool value);
+  bool Number(double value);
+  bool String(const char *str, size_t len);
+  bool StartObject();
+  bool Key(const char *str, size_t len);
+  bool EndObject();
+  bool StartArray();
+  bool EndArray();
+
+private:
+  // the key of the data object whose value is being read
+  enum Field
+  {
+    kFieldNone,
+    kFieldX,
+    kFieldY,
+    kFieldS,
+    kFieldD,
+    kFieldYaw,
+    kFieldSpeed,
+    kFieldPreviousPathX,
+    kFieldPreviousPathY,
+    kFieldEndPathS,
+    kFieldEndPathD,
+    kFieldSensorFusion,
+    kFieldSeq
+  };
+
+  // the second element of the event array
+  enum Data
+  {
+    kDataMissing,
+    kDataNull,
+    kDataObject,
+    kDataOther
+  };
+
+  // count an element of the event array that is not a string, false if it is the first one
+  bool Element(Data data);
+
+  // reading the data object of a telemetry event
+  bool InData() const;
+
+  Telemetry &telemetry_;
+
+  int depth_;           // open arrays and objects
+  int elements_;        // elements of the event array so far
+  bool is_telemetry_;   // the event name is "telemetry"
+  Data data_;
+  Field field_;
+  int prev_size_y_;
+  int column_;          // next column of the sensor fusion row being read
+};
+
+// decode a websocket frame straight from the buffer uWS hands to onMessage.
+// reads exactly length bytes, the buffer does not need to be null terminated.
+// nothing is copied or allocated, numbers are parsed in place.
+TelemetryEvent DecodeTelemetry(const char *data, size_t length, Telemetry &telemetry);
+
+// decode a binary telemetry frame, see binary_frame.h. kEventNone if it is not
+// one, kEventInvalid if it is truncated or has more points or cars than fit.
+TelemetryEvent DecodeBinaryTelemetry(const char *data, size_t length, Telemetry &telemetry);
+
+// the binary telemetry frame of telemetry, for clients. returns the length
+// written to out, which needs BinaryTelemetrySize bytes.
+size_t BinaryTelemetrySize(const Telemetry &telemetry);
+size_t EncodeBinaryTelemetry(const Telemetry &telemetry, char *out);
+
+#endif // TELEMETRY_H
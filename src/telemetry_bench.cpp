@@ -0,0 +1,383 @@
+// benchmark of the simulator protocol: DecodeTelemetry against the hasData +
+// json::parse path the planner used before, on synthetic telemetry frames
+// shaped like the simulator's with a growing number of sensor fusion cars,
+// and ControlMessage against building the reply with json dump(). the same
+// frames in the binary protocol of binary_frame.h are timed alongside, and
+// the delta control frames against the full ones. before that it checks that
+// JsonWriteNumber writes the fewest significant digits that read back.
+// reports time and heap allocations per frame.
+//
+// usage: telemetry_bench [iterations]
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "control_message.h"
+#include "json.hpp"
+#include "json_sax.h"
+#include "telemetry.h"
+
+using namespace std;
+
+using json = nlohmann::json;
+
+// every heap allocation of the process goes through here
+static long allocations = 0;
+
+void *operator new(size_t size)
+{
+  allocations++;
+  void *ptr = malloc(size ? size : 1);
+  if (ptr == NULL) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+// out of line, or the compiler sees free() take a pointer from operator new
+// wherever a delete is inlined and warns about the mismatch
+static __attribute__((noinline)) void HeapFree(void *ptr)
+{
+  free(ptr);
+}
+
+// plain and sized delete, a C++14 compiler calls the sized one
+void operator delete(void *ptr) noexcept
+{
+  HeapFree(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  HeapFree(ptr);
+}
+
+// the previous SocketIO check, kept here as the baseline
+static string hasData(string s) {
+  auto found_null = s.find("null");
+  auto b1 = s.find_first_of("[");
+  auto b2 = s.find_first_of("}");
+  if (found_null != string::npos) {
+    return "";
+  } else if (b1 != string::npos && b2 != string::npos) {
+    return s.substr(b1, b2 - b1 + 2);
+  }
+  return "";
+}
+
+// a telemetry frame with 40 previous path points and num_cars cars
+static string MakeFrame(int num_cars, mt19937 &rng)
+{
+  uniform_real_distribution<double> pos(0, 3000);
+  uniform_real_distribution<double> vel(-25, 25);
+  uniform_real_distribution<double> lane_d(0, 12);
+
+  char number[32];
+  auto num = [&number](double v) { snprintf(number, sizeof(number), "%.17g", v); return string(number); };
+
+  string frame = "42[\"telemetry\",{\"x\":" + num(pos(rng)) + ",\"y\":" + num(pos(rng));
+  frame += ",\"yaw\":" + num(vel(rng)) + ",\"speed\":" + num(vel(rng) + 25);
+  frame += ",\"s\":" + num(pos(rng)) + ",\"d\":" + num(lane_d(rng));
+
+  for (int k = 0; k < 2; k++) {
+    frame += k == 0 ? ",\"previous_path_x\":[" : "],\"previous_path_y\":[";
+    for (int i = 0; i < 40; i++) {
+      frame += (i ? "," : "") + num(pos(rng));
+    }
+  }
+  frame += "],\"end_path_s\":" + num(pos(rng)) + ",\"end_path_d\":" + num(lane_d(rng));
+
+  frame += ",\"sensor_fusion\":[";
+  for (int i = 0; i < num_cars; i++) {
+    frame += (i ? ",[" : "[") + to_string(i) + "," + num(pos(rng)) + "," + num(pos(rng)) + ",";
+    frame += num(vel(rng)) + "," + num(vel(rng)) + "," + num(pos(rng)) + "," + num(lane_d(rng)) + "]";
+  }
+  frame += "]}]";
+
+  return frame;
+}
+
+// read the values the planner reads, so neither path can skip work
+static double ConsumeJson(const char *data)
+{
+  auto s = hasData(data);
+  auto j = json::parse(s);
+  double sum = (double)j[1]["x"] + (double)j[1]["y"] + (double)j[1]["s"] + (double)j[1]["d"];
+  sum += (double)j[1]["yaw"] + (double)j[1]["speed"] + (double)j[1]["end_path_s"] + (double)j[1]["end_path_d"];
+  auto previous_path_x = j[1]["previous_path_x"];
+  auto previous_path_y = j[1]["previous_path_y"];
+  for (size_t i = 0; i < previous_path_x.size(); i++) {
+    sum += (double)previous_path_x[i] + (double)previous_path_y[i];
+  }
+  auto sensor_fusion = j[1]["sensor_fusion"];
+  for (size_t i = 0; i < sensor_fusion.size(); i++) {
+    for (int k = 0; k < 7; k++) {
+      sum += (double)sensor_fusion[i][k];
+    }
+  }
+  return sum;
+}
+
+static double ConsumeTelemetry(const char *data, size_t length, Telemetry &telemetry, bool binary = false)
+{
+  TelemetryEvent event = binary ? DecodeBinaryTelemetry(data, length, telemetry)
+                                : DecodeTelemetry(data, length, telemetry);
+  if (event != kEventTelemetry) {
+    return 0;
+  }
+  double sum = telemetry.x + telemetry.y + telemetry.s + telemetry.d;
+  sum += telemetry.yaw + telemetry.speed + telemetry.end_path_s + telemetry.end_path_d;
+  for (int i = 0; i < telemetry.prev_size; i++) {
+    sum += telemetry.previous_path_x[i] + telemetry.previous_path_y[i];
+  }
+  for (int i = 0; i < telemetry.num_cars; i++) {
+    const double *row = &telemetry.sensor_fusion[i].id;
+    for (int k = 0; k < 7; k++) {
+      sum += row[k];
+    }
+  }
+  return sum;
+}
+
+// the reply as the planner built it before
+static string DumpControl(const vector<double> &next_x_vals, const vector<double> &next_y_vals)
+{
+  json msgJson;
+  msgJson["next_x"] = next_x_vals;
+  msgJson["next_y"] = next_y_vals;
+  return "42[\"control\","+ msgJson.dump()+"]";
+}
+
+// both replies have to read back as the same path, the new one exactly
+static bool SameControl(const string &dumped, const ControlMessage &control,
+                        const vector<double> &next_x_vals, const vector<double> &next_y_vals)
+{
+  json old_j = json::parse(dumped.substr(2));
+  json new_j = json::parse(string(control.data(), control.length()).substr(2));
+  if (old_j[0] != new_j[0] || old_j[1].size() != new_j[1].size()) {
+    return false;
+  }
+  for (size_t i = 0; i < next_x_vals.size(); i++) {
+    if ((double)new_j[1]["next_x"][i] != next_x_vals[i] || (double)new_j[1]["next_y"][i] != next_y_vals[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// significant digits of a number as JsonWriteNumber writes it
+static int SignificantDigits(const char *text, int length)
+{
+  string digits;
+  for (int i = 0; i < length && text[i] != 'e' && text[i] != 'E'; i++) {
+    if (text[i] >= '0' && text[i] <= '9' && (text[i] != '0' || !digits.empty())) {
+      digits += text[i];
+    }
+  }
+  size_t last = digits.find_last_not_of('0');
+  return (last == string::npos) ? 0 : last + 1;
+}
+
+// the fewest significant digits that strtod reads back as value
+static int ShortestDigits(double value)
+{
+  char buffer[kJsonMaxNumberLength];
+  for (int precision = 1; precision < 17; precision++) {
+    snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, value);
+    if (strtod(buffer, NULL) == value) {
+      return precision;
+    }
+  }
+  return 17;
+}
+
+// JsonWriteNumber against the shortest digits found with snprintf and strtod,
+// on random doubles of any exponent, positions and offsets like the planner's,
+// and values its fast check can't decide. every text has to read back exactly.
+static bool CheckWriteNumber(mt19937 &rng)
+{
+  vector<double> values = {0.0, -0.0, 1.0, 0.1, 1e22, 1e23, 5e-324, 1.7976931348623157e308,
+                           -5.8203069612089527e-08};
+  uniform_int_distribution<uint64_t> bits;
+  uniform_real_distribution<double> pos(0, 3000);
+  uniform_real_distribution<double> small(-1e-6, 1e-6);
+  for (int i = 0; i < 100000; i++) {
+    uint64_t raw = bits(rng);
+    double value;
+    memcpy(&value, &raw, sizeof(value));
+    if (isfinite(value)) {
+      values.push_back(value);
+    }
+    values.push_back(pos(rng));
+    values.push_back(small(rng));
+  }
+
+  char text[kJsonMaxNumberLength + 1];
+  long longer = 0;
+  for (double value : values) {
+    int length = JsonWriteNumber(value, text);
+    text[length] = 0;
+    if (strtod(text, NULL) != value || signbit(strtod(text, NULL)) != signbit(value)) {
+      std::cerr << "JsonWriteNumber wrote " << text << ", which does not read back" << std::endl;
+      return false;
+    }
+    if (value != 0 && SignificantDigits(text, length) != ShortestDigits(value)) {
+      if (longer == 0) {
+        std::cerr << "JsonWriteNumber wrote " << text << ", " << SignificantDigits(text, length) << " digits for ";
+        std::cerr << ShortestDigits(value) << std::endl;
+      }
+      longer++;
+    }
+  }
+
+  printf("numbers  shortest\n%7zu  %8zu\n\n", values.size(), values.size() - longer);
+  return longer == 0;
+}
+
+static void BenchControl(int iterations, mt19937 &rng)
+{
+  uniform_real_distribution<double> pos(0, 3000);
+  vector<double> next_x_vals(50);
+  vector<double> next_y_vals(50);
+  for (int i = 0; i < 50; i++) {
+    next_x_vals[i] = pos(rng);
+    next_y_vals[i] = pos(rng);
+  }
+
+  ControlMessage control;
+  control.Write(next_x_vals.data(), next_y_vals.data(), next_x_vals.size());
+  if (!SameControl(DumpControl(next_x_vals, next_y_vals), control, next_x_vals, next_y_vals)) {
+    std::cerr << "control frames differ" << std::endl;
+    exit(1);
+  }
+
+  size_t sink = 0;
+
+  long start_allocations = allocations;
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    sink += DumpControl(next_x_vals, next_y_vals).size();
+  }
+  double dump_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+  double dump_allocs = (double)(allocations - start_allocations) / iterations;
+
+  start_allocations = allocations;
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    control.Write(next_x_vals.data(), next_y_vals.data(), next_x_vals.size());
+    sink += control.length();
+  }
+  double write_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+  double write_allocs = (double)(allocations - start_allocations) / iterations;
+  size_t write_bytes = control.length();
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    control.WriteBinary(next_x_vals.data(), next_y_vals.data(), next_x_vals.size());
+    sink += control.length();
+  }
+  double binary_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+  size_t binary_bytes = control.length();
+
+  // a client in delta mode keeps the 48 points it sent, the tick appends 2
+  const int base = 48;
+  int appended = next_x_vals.size() - base;
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    control.WriteDelta(i, base, next_x_vals.data() + base, next_y_vals.data() + base, appended);
+    sink += control.length();
+  }
+  double delta_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+  size_t delta_bytes = control.length();
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    control.WriteBinaryDelta(i, base, next_x_vals.data() + base, next_y_vals.data() + base, appended);
+    sink += control.length();
+  }
+  double binary_delta_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+  size_t binary_delta_bytes = control.length();
+
+  std::cout << std::endl << "points  dump bytes  dump us/frame  allocs  write bytes  write us/frame  allocs  speedup";
+  std::cout << "  binary bytes  binary us/frame" << std::endl;
+  printf("%6d  %10zu  %13.2f  %6.0f  %11zu  %14.2f  %6.0f  %6.1fx  %12zu  %15.2f%s\n", 50,
+         DumpControl(next_x_vals, next_y_vals).size(), dump_us, dump_allocs, write_bytes, write_us, write_allocs,
+         dump_us / write_us, binary_bytes, binary_us, sink == 0 ? " " : "");
+
+  std::cout << std::endl << "delta  text bytes  text us/frame  saved  binary bytes  binary us/frame  saved" << std::endl;
+  printf("%2d+%-2d  %10zu  %13.2f  %4.0f%%  %12zu  %15.2f  %4.0f%%\n", base, appended, delta_bytes, delta_us,
+         100 - 100.0 * delta_bytes / write_bytes, binary_delta_bytes, binary_delta_us,
+         100 - 100.0 * binary_delta_bytes / binary_bytes);
+}
+
+int main(int argc, char **argv) {
+  int iterations = (argc > 1) ? atoi(argv[1]) : 2000;
+
+  mt19937 rng(42);
+  static Telemetry telemetry;
+
+  if (!CheckWriteNumber(rng)) {
+    return 1;
+  }
+
+  std::cout << "cars  frame bytes  json us/frame  allocs  decode us/frame  allocs  speedup  binary bytes  binary us/frame";
+  std::cout << std::endl;
+
+  const int car_counts[] = {12, 50, 100, 200, 500};
+  for (int num_cars : car_counts) {
+    string frame = MakeFrame(num_cars, rng);
+
+    // both paths have to agree before their times mean anything
+    double json_sum = ConsumeJson(frame.c_str());
+    double decode_sum = ConsumeTelemetry(frame.data(), frame.size(), telemetry);
+    vector<char> binary(BinaryTelemetrySize(telemetry));
+    EncodeBinaryTelemetry(telemetry, binary.data());
+    double binary_sum = ConsumeTelemetry(binary.data(), binary.size(), telemetry, true);
+    if (json_sum != decode_sum || binary_sum != decode_sum) {
+      std::cerr << "decoded values differ for " << num_cars << " cars" << std::endl;
+      return 1;
+    }
+
+    double sink = 0;
+
+    long start_allocations = allocations;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      sink += ConsumeJson(frame.c_str());
+    }
+    double json_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+    double json_allocs = (double)(allocations - start_allocations) / iterations;
+
+    start_allocations = allocations;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      sink += ConsumeTelemetry(frame.data(), frame.size(), telemetry);
+    }
+    double decode_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+    double decode_allocs = (double)(allocations - start_allocations) / iterations;
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      sink += ConsumeTelemetry(binary.data(), binary.size(), telemetry, true);
+    }
+    double binary_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / iterations;
+
+    printf("%4d  %11zu  %13.2f  %6.0f  %15.2f  %6.0f  %6.1fx  %12zu  %15.2f%s\n", num_cars, frame.size(), json_us,
+           json_allocs, decode_us, decode_allocs, json_us / decode_us, binary.size(), binary_us, sink == 0 ? " " : "");
+  }
+
+  BenchControl(iterations, rng);
+
+  return 0;
+}
@@ -0,0 +1,607 @@
+#include "tiled_map.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include "frenet.h"
+
+using namespace std;
+
+// read bytes at offset, resuming after short reads. false on an error or if
+// the file ends first.
+static bool ReadAt(int fd, void *buffer, size_t bytes, off_t offset)
+{
+  char *out = (char *)buffer;
+  while(bytes > 0)
+  {
+    ssize_t got = pread(fd, out, bytes, offset);
+    if(got < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if(got <= 0)
+    {
+      return false;
+    }
+    out += got;
+    bytes -= got;
+    offset += got;
+  }
+
+  return true;
+}
+
+bool WriteTiledMap(const string &path, const MapWaypoints &waypoints, double max_s, double tile_length)
+{
+  int n = waypoints.x.size();
+  if(n < 2 || tile_length <= 0)
+  {
+    return false;
+  }
+
+  TiledMapHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kTiledMapMagic, sizeof(header.magic));
+  header.version = kTiledMapVersion;
+  header.num_tiles = (uint32_t)ceil(max_s / tile_length);
+  header.num_waypoints = n;
+  header.max_s = max_s;
+  header.tile_length = tile_length;
+
+  vector<TiledMapTileEntry> directory(header.num_tiles);
+  vector<TiledMapWaypoint> records;
+
+  uint64_t offset = sizeof(header) + directory.size() * sizeof(TiledMapTileEntry);
+  const double *map_s = waypoints.s.data();
+
+  for(uint32_t t = 0; t < header.num_tiles; t++)
+  {
+    // waypoints with s in [t*tile_length, (t+1)*tile_length), the last tile takes everything after it
+    int first = lower_bound(map_s, map_s + n, t * tile_length) - map_s;
+    int end = (t + 1 == header.num_tiles) ? n : lower_bound(map_s, map_s + n, (t + 1) * tile_length) - map_s;
+
+    TiledMapTileEntry &entry = directory[t];
+    entry.offset = offset;
+    entry.count = end - first;
+    entry.min_x = entry.min_y = numeric_limits<double>::max();
+    entry.max_x = entry.max_y = -numeric_limits<double>::max();
+
+    // the waypoint before the tile, the ones inside and the one after it, with s unwrapped
+    for(int i = first - 1; i <= end; i++)
+    {
+      int wp = (i + n) % n;
+      double s_offset = (i < 0) ? -max_s : (i >= n) ? max_s : 0;
+
+      TiledMapWaypoint record = {waypoints.x[wp], waypoints.y[wp], waypoints.s[wp] + s_offset,
+                                 waypoints.dx[wp], waypoints.dy[wp]};
+      records.push_back(record);
+
+      if(i >= first && i < end)
+      {
+        entry.min_x = min(entry.min_x, record.x);
+        entry.min_y = min(entry.min_y, record.y);
+        entry.max_x = max(entry.max_x, record.x);
+        entry.max_y = max(entry.max_y, record.y);
+      }
+    }
+
+    offset += (entry.count + 2) * sizeof(TiledMapWaypoint);
+  }
+
+  ofstream out(path.c_str(), ofstream::binary | ofstream::trunc);
+  out.write((const char *)&header, sizeof(header));
+  out.write((const char *)directory.data(), directory.size() * sizeof(TiledMapTileEntry));
+  out.write((const char *)records.data(), records.size() * sizeof(TiledMapWaypoint));
+
+  return (bool)out;
+}
+
+TiledMap::TiledMap(int max_resident)
+  : fd_(-1), max_resident_(max(max_resident, 1)), stop_(false), last_tile_(-1)
+{
+  memset(&header_, 0, sizeof(header_));
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+TiledMap::~TiledMap()
+{
+  {
+    lock_guard<mutex> lock(queue_mutex_);
+    stop_ = true;
+  }
+  queue_cv_.notify_all();
+  if(prefetch_thread_.joinable())
+  {
+    prefetch_thread_.join();
+  }
+
+  if(fd_ >= 0)
+  {
+    close(fd_);
+  }
+}
+
+bool TiledMap::Open(const string &path, string &error)
+{
+  if(fd_ >= 0)
+  {
+    error = "tiled map is already open";
+    return false;
+  }
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    error = "can't open " + path;
+    return false;
+  }
+
+  struct stat st;
+  TiledMapHeader header;
+  if(fstat(fd, &st) != 0 || !ReadAt(fd, &header, sizeof(header), 0))
+  {
+    close(fd);
+    error = path + " is too short for a tiled map file";
+    return false;
+  }
+
+  if(memcmp(header.magic, kTiledMapMagic, sizeof(kTiledMapMagic)) != 0)
+  {
+    error = path + " is not a tiled map file";
+  }
+  else if(header.version != kTiledMapVersion)
+  {
+    error = path + " has an unsupported tiled map file version";
+  }
+  else if(header.num_tiles == 0 || !(header.tile_length > 0) || !(header.max_s > 0))
+  {
+    error = path + " has no tiles";
+  }
+
+  vector<TiledMapTileEntry> directory;
+  if(error.empty())
+  {
+    directory.resize(header.num_tiles);
+    if(!ReadAt(fd, directory.data(), directory.size() * sizeof(TiledMapTileEntry), sizeof(header)))
+    {
+      error = path + " has a truncated tile directory";
+    }
+  }
+
+  for(size_t t = 0; error.empty() && t < directory.size(); t++)
+  {
+    uint64_t tile_bytes = (directory[t].count + 2) * (uint64_t)sizeof(TiledMapWaypoint);
+    if(directory[t].offset > (uint64_t)st.st_size || st.st_size - directory[t].offset < tile_bytes)
+    {
+      error = path + " is truncated or has a bad tile directory";
+    }
+
+    // the waypoints of a tile lie within its s length of each other, the
+    // grid below relies on their bounding box spanning only a few cells
+    double span = max(directory[t].max_x - directory[t].min_x, directory[t].max_y - directory[t].min_y);
+    if(directory[t].count > 0 && !(span <= 2 * header.tile_length))
+    {
+      error = path + " has a tile larger than its s length";
+    }
+  }
+
+  if(!error.empty())
+  {
+    close(fd);
+    return false;
+  }
+
+  fd_ = fd;
+  header_ = header;
+  directory_.swap(directory);
+
+  for(size_t t = 0; t < directory_.size(); t++)
+  {
+    const TiledMapTileEntry &entry = directory_[t];
+    if(entry.count == 0)
+    {
+      continue;
+    }
+    for(int64_t col = Cell(entry.min_x); col <= Cell(entry.max_x); col++)
+    {
+      for(int64_t row = Cell(entry.min_y); row <= Cell(entry.max_y); row++)
+      {
+        grid_[CellKey(col, row)].push_back(t);
+      }
+    }
+  }
+
+  prefetch_thread_ = thread(&TiledMap::PrefetchLoop, this);
+
+  return true;
+}
+
+void TiledMap::Prefetch(double s, double behind, double ahead)
+{
+  if(fd_ < 0)
+  {
+    return;
+  }
+
+  int first = TileOf(WrapS(s - behind));
+  int count = (int)ceil((behind + ahead) / header_.tile_length) + 1;
+
+  // never ask for more than fits, or the prefetch would evict its own tiles
+  count = min(count, min(max_resident_, (int)header_.num_tiles));
+
+  bool queued = false;
+  {
+    lock_guard<mutex> lock(queue_mutex_);
+    for(int i = 0; i < count; i++)
+    {
+      int tile = (first + i) % header_.num_tiles;
+      if(find(queue_.begin(), queue_.end(), tile) == queue_.end() && !IsResident(tile))
+      {
+        queue_.push_back(tile);
+        queued = true;
+      }
+    }
+  }
+
+  if(queued)
+  {
+    queue_cv_.notify_one();
+  }
+}
+
+bool TiledMap::getFrenet(double x, double y, double theta, double &s, double &d)
+{
+  // seed the search with the tile of the last query, or on the first one with
+  // the one with the nearest bounding box
+  int seed = last_tile_;
+  if(seed < 0 || directory_[seed].count == 0)
+  {
+    double seed_dist2 = numeric_limits<double>::max();
+    for(size_t t = 0; t < directory_.size(); t++)
+    {
+      const TiledMapTileEntry &entry = directory_[t];
+      if(entry.count == 0)
+      {
+        continue;
+      }
+      double bx = max(max(entry.min_x - x, x - entry.max_x), 0.0);
+      double by = max(max(entry.min_y - y, y - entry.max_y), 0.0);
+      if(bx*bx + by*by < seed_dist2)
+      {
+        seed_dist2 = bx*bx + by*by;
+        seed = t;
+      }
+    }
+  }
+
+  Nearest nearest;
+  nearest.tile = -1;
+  nearest.wp = -1;
+  nearest.dist2 = numeric_limits<double>::max();
+  if(!NearerInTile(seed, x, y, nearest))
+  {
+    return false;
+  }
+
+  // only tiles whose bounding box is nearer than the best waypoint so far can
+  // hold a closer one. those overlap the cells within that distance, unless
+  // the point is so far from the route that the cells outnumber the tiles.
+  double radius = sqrt(nearest.dist2);
+  int64_t first_col = Cell(x - radius);
+  int64_t last_col = Cell(x + radius);
+  int64_t first_row = Cell(y - radius);
+  int64_t last_row = Cell(y + radius);
+  double cells = (double)(last_col - first_col + 1) * (last_row - first_row + 1);
+  if(cells <= directory_.size())
+  {
+    for(int64_t col = first_col; col <= last_col; col++)
+    {
+      for(int64_t row = first_row; row <= last_row; row++)
+      {
+        auto it = grid_.find(CellKey(col, row));
+        if(it == grid_.end())
+        {
+          continue;
+        }
+        for(int tile : it->second)
+        {
+          if(!NearerInTile(tile, x, y, nearest))
+          {
+            return false;
+          }
+        }
+      }
+    }
+  }
+  else
+  {
+    for(size_t t = 0; t < directory_.size(); t++)
+    {
+      if(!NearerInTile(t, x, y, nearest))
+      {
+        return false;
+      }
+    }
+  }
+  last_tile_ = nearest.tile;
+
+  const MapTile &tile = *nearest.ptr;
+
+  // next waypoint in positive s-direction, like NextWaypoint. the waypoint after
+  // the tile is stored with it, so next_wp stays inside the tile.
+  int next_wp = nearest.wp;
+  double heading = atan2((tile.y[next_wp]-y),(tile.x[next_wp]-x));
+  double angle = fabs(theta-heading);
+  angle = min(2*pi() - angle, angle);
+  if(angle > pi()/4)
+  {
+    next_wp++;
+  }
+  int prev_wp = next_wp-1;
+
+  double n_x = tile.x[next_wp]-tile.x[prev_wp];
+  double n_y = tile.y[next_wp]-tile.y[prev_wp];
+  double x_x = x - tile.x[prev_wp];
+  double x_y = y - tile.y[prev_wp];
+
+  // find the projection of x onto n
+  double proj_norm = (x_x*n_x+x_y*n_y)/(n_x*n_x+n_y*n_y);
+  double proj_x = proj_norm*n_x;
+  double proj_y = proj_norm*n_y;
+
+  // signed distance along the right-hand normal of the segment
+  d = x_x*tile.normal_x[prev_wp] + x_y*tile.normal_y[prev_wp];
+  s = WrapS(tile.s[prev_wp] + distance(0,0,proj_x,proj_y));
+
+  return true;
+}
+
+bool TiledMap::getXY(double s, double d, double &x, double &y)
+{
+  s = WrapS(s);
+
+  TilePtr ptr = Tile(TileOf(s));
+  if(!ptr)
+  {
+    return false;
+  }
+  const MapTile &tile = *ptr;
+
+  // last waypoint at or before s. the waypoint before the tile has a smaller s
+  // and the one after it a larger one, so the segment is always in the tile.
+  int last = tile.s.size() - 2;
+  int prev_wp = (upper_bound(tile.s.begin(), tile.s.end(), s) - tile.s.begin()) - 1;
+  prev_wp = min(max(prev_wp, 0), last);
+
+  double seg_s = s - tile.s[prev_wp];
+
+  x = tile.x[prev_wp] + seg_s*tile.tangent_x[prev_wp] + d*tile.normal_x[prev_wp];
+  y = tile.y[prev_wp] + seg_s*tile.tangent_y[prev_wp] + d*tile.normal_y[prev_wp];
+
+  return true;
+}
+
+TiledMap::Stats TiledMap::stats()
+{
+  lock_guard<mutex> lock(cache_mutex_);
+
+  Stats stats = stats_;
+  stats.resident = lru_.size();
+
+  return stats;
+}
+
+double TiledMap::WrapS(double s) const
+{
+  s = fmod(s, header_.max_s);
+  if(s < 0)
+  {
+    s += header_.max_s;
+  }
+
+  return s;
+}
+
+int TiledMap::TileOf(double s) const
+{
+  int tile = (int)(s / header_.tile_length);
+
+  return min(max(tile, 0), (int)header_.num_tiles - 1);
+}
+
+int64_t TiledMap::Cell(double coord) const
+{
+  return (int64_t)floor(coord / header_.tile_length);
+}
+
+uint64_t TiledMap::CellKey(int64_t col, int64_t row)
+{
+  return ((uint64_t)(uint32_t)col << 32) | (uint32_t)row;
+}
+
+bool TiledMap::NearerInTile(int tile, double x, double y, Nearest &nearest)
+{
+  const TiledMapTileEntry &entry = directory_[tile];
+  if(tile == nearest.tile || entry.count == 0)
+  {
+    return true;
+  }
+  double bx = max(max(entry.min_x - x, x - entry.max_x), 0.0);
+  double by = max(max(entry.min_y - y, y - entry.max_y), 0.0);
+  if(bx*bx + by*by >= nearest.dist2)
+  {
+    return true;
+  }
+
+  TilePtr ptr = Tile(tile);
+  if(!ptr)
+  {
+    return false;
+  }
+
+  // the tree only holds the waypoints inside the tile, which start at local index 1
+  int wp = ptr->tree.Closest(x, y) + 1;
+
+  double dx = ptr->x[wp] - x;
+  double dy = ptr->y[wp] - y;
+  double dist2 = dx*dx + dy*dy;
+  if(dist2 < nearest.dist2)
+  {
+    nearest.ptr = ptr;
+    nearest.tile = tile;
+    nearest.wp = wp;
+    nearest.dist2 = dist2;
+  }
+
+  return true;
+}
+
+TiledMap::TilePtr TiledMap::Tile(int tile)
+{
+  {
+    lock_guard<mutex> lock(cache_mutex_);
+
+    auto it = cache_.find(tile);
+    if(it != cache_.end())
+    {
+      // move to the front of the LRU list
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return it->second->second;
+    }
+
+    stats_.sync_loads++;
+  }
+
+  // a tile that can't be read is not cached, the next query reads it again
+  TilePtr ptr = Load(tile);
+  if(ptr)
+  {
+    Insert(tile, ptr);
+  }
+
+  return ptr;
+}
+
+bool TiledMap::IsResident(int tile)
+{
+  lock_guard<mutex> lock(cache_mutex_);
+
+  return cache_.count(tile) != 0;
+}
+
+// read a tile from the file, runs without holding a lock
+TiledMap::TilePtr TiledMap::Load(int tile)
+{
+  const TiledMapTileEntry &entry = directory_[tile];
+  int n = entry.count + 2;
+
+  vector<TiledMapWaypoint> records(n);
+  if(!ReadAt(fd_, records.data(), n * sizeof(TiledMapWaypoint), entry.offset))
+  {
+    // the directory was checked against the file size, so this is an I/O
+    // error or a file that changed since
+    std::cerr << "Failed to read map tile " << tile << std::endl;
+
+    lock_guard<mutex> lock(cache_mutex_);
+    stats_.failed_loads++;
+    return TilePtr();
+  }
+
+  shared_ptr<MapTile> ptr = make_shared<MapTile>();
+  MapTile &map_tile = *ptr;
+  map_tile.x.resize(n);
+  map_tile.y.resize(n);
+  map_tile.s.resize(n);
+  map_tile.tangent_x.resize(n);
+  map_tile.tangent_y.resize(n);
+  map_tile.normal_x.resize(n);
+  map_tile.normal_y.resize(n);
+
+  for(int i = 0; i < n; i++)
+  {
+    map_tile.x[i] = records[i].x;
+    map_tile.y[i] = records[i].y;
+    map_tile.s[i] = records[i].s;
+  }
+
+  // same per-segment data as HighwayMap, the waypoint after the tile starts no segment of it
+  for(int i = 0; i < n; i++)
+  {
+    int next = min(i + 1, n - 1);
+    int prev = next - 1;
+    double length = distance(map_tile.x[prev], map_tile.y[prev], map_tile.x[next], map_tile.y[next]);
+    map_tile.tangent_x[i] = (map_tile.x[next] - map_tile.x[prev]) / length;
+    map_tile.tangent_y[i] = (map_tile.y[next] - map_tile.y[prev]) / length;
+    map_tile.normal_x[i] = map_tile.tangent_y[i];
+    map_tile.normal_y[i] = -map_tile.tangent_x[i];
+  }
+
+  map_tile.tree.Build(map_tile.x.data() + 1, map_tile.y.data() + 1, entry.count);
+
+  return ptr;
+}
+
+void TiledMap::Insert(int tile, const TilePtr &ptr)
+{
+  lock_guard<mutex> lock(cache_mutex_);
+
+  stats_.loads++;
+
+  // loaded twice by a query and the prefetch thread, keep the first one
+  auto it = cache_.find(tile);
+  if(it != cache_.end())
+  {
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return;
+  }
+
+  lru_.push_front(make_pair(tile, ptr));
+  cache_[tile] = lru_.begin();
+
+  // queries still holding an evicted tile keep it alive until they are done
+  while((int)lru_.size() > max_resident_)
+  {
+    cache_.erase(lru_.back().first);
+    lru_.pop_back();
+    stats_.evictions++;
+  }
+}
+
+void TiledMap::PrefetchLoop()
+{
+  for(;;)
+  {
+    int tile;
+    {
+      unique_lock<mutex> lock(queue_mutex_);
+      while(!stop_ && queue_.empty())
+      {
+        queue_cv_.wait(lock);
+      }
+      if(stop_)
+      {
+        return;
+      }
+      tile = queue_.front();
+      queue_.pop_front();
+    }
+
+    if(!IsResident(tile))
+    {
+      TilePtr ptr = Load(tile);
+      if(ptr)
+      {
+        Insert(tile, ptr);
+      }
+    }
+  }
+}
@@ -0,0 +1,189 @@
+#ifndef TILED_MAP_H
+#define TILED_MAP_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "map_file.h"
+#include "waypoint_kdtree.h"
+
+// tiled map file for routes too long to keep in memory. the route is cut into
+// tiles of equal s length. only a small directory is read up front, the
+// waypoints of a tile are read when it is needed.
+//
+// layout: a TiledMapHeader, num_tiles TiledMapTileEntry records, then the
+// waypoints of every tile as count+2 TiledMapWaypoint records: the waypoint
+// before the tile, the count waypoints with s inside the tile and the waypoint
+// after it. the two neighbours make the segments across tile boundaries
+// complete. their s is unwrapped, so s increases through every tile.
+
+static const char kTiledMapMagic[8] = {'P', 'P', 'T', 'I', 'L', 'E', 'S', 0};
+static const uint32_t kTiledMapVersion = 1;
+
+struct TiledMapHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t num_tiles;
+  uint64_t num_waypoints;
+  double max_s;
+  double tile_length;
+};
+
+struct TiledMapTileEntry
+{
+  uint64_t offset;      // file offset of the tile's waypoint records
+  uint32_t count;       // waypoints with s inside the tile
+  uint32_t reserved;
+  double min_x;         // bounding box of the count waypoints
+  double min_y;
+  double max_x;
+  double max_y;
+};
+
+struct TiledMapWaypoint
+{
+  double x;
+  double y;
+  double s;
+  double dx;
+  double dy;
+};
+
+// cut the waypoints into tiles of tile_length meters of s and write the tiled map file
+bool WriteTiledMap(const std::string &path, const MapWaypoints &waypoints, double max_s, double tile_length);
+
+// one resident tile
+struct MapTile
+{
+  // count+2 waypoints, see the file layout above
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> s;
+
+  // unit tangent and right-hand normal of the segment starting at each waypoint
+  std::vector<double> tangent_x;
+  std::vector<double> tangent_y;
+  std::vector<double> normal_x;
+  std::vector<double> normal_y;
+
+  // spatial index over the count waypoints inside the tile (local index - 1)
+  WaypointKdTree tree;
+};
+
+// tile store with a bounded LRU cache of resident tiles. Prefetch() hands the
+// tiles around the car to a background thread, queries that hit a tile that
+// is not resident load it on the spot. getFrenet and getXY work across tile
+// boundaries as if the whole route was in memory. a tile that can't be read
+// is not cached, the queries that need it fail and it is read again when it
+// is next needed. like FrenetTracker, the queries of one instance are meant
+// to come from one thread.
+class TiledMap
+{
+public:
+  struct Stats
+  {
+    long loads;           // tiles read from the file
+    long sync_loads;      // of which a query had to wait for
+    long failed_loads;    // reads that failed, the tile stays unloaded
+    long evictions;       // tiles dropped from the cache
+    int resident;         // tiles in memory right now
+  };
+
+  // max_resident bounds the number of tiles in memory
+  explicit TiledMap(int max_resident = 8);
+  ~TiledMap();
+
+  // read header and directory and start the prefetch thread
+  bool Open(const std::string &path, std::string &error);
+
+  double max_s() const { return header_.max_s; }
+  double tile_length() const { return header_.tile_length; }
+  int num_tiles() const { return header_.num_tiles; }
+
+  // queue the tiles from behind meters behind s to ahead meters in front of it for loading
+  void Prefetch(double s, double behind = 100, double ahead = 500);
+
+  // transform from Cartesian x,y coordinates to Frenet s,d coordinates.
+  // d is positive to the right of the route, like in getXY. false if a tile
+  // it needs can't be read, s and d are left alone then.
+  bool getFrenet(double x, double y, double theta, double &s, double &d);
+
+  // transform from Frenet s,d coordinates to Cartesian x,y. false if the
+  // tile can't be read, x and y are left alone then.
+  bool getXY(double s, double d, double &x, double &y);
+
+  Stats stats();
+
+private:
+  TiledMap(const TiledMap &);
+  TiledMap &operator=(const TiledMap &);
+
+  typedef std::shared_ptr<const MapTile> TilePtr;
+
+  // closest waypoint to a point found so far
+  struct Nearest
+  {
+    TilePtr ptr;
+    int tile;
+    int wp;               // local index in the tile
+    double dist2;
+  };
+
+  double WrapS(double s) const;
+  int TileOf(double s) const;
+
+  // grid cell of a coordinate and the key of a cell
+  int64_t Cell(double coord) const;
+  static uint64_t CellKey(int64_t col, int64_t row);
+
+  // replace nearest by the closest waypoint of tile if that is closer. the
+  // tile is only read if its bounding box is. false if it can't be read.
+  bool NearerInTile(int tile, double x, double y, Nearest &nearest);
+
+  // resident tile, loaded synchronously if needed. null if it can't be read.
+  TilePtr Tile(int tile);
+  bool IsResident(int tile);
+  // read a tile from the file, null if the read fails or comes up short
+  TilePtr Load(int tile);
+  void Insert(int tile, const TilePtr &ptr);
+
+  void PrefetchLoop();
+
+  int fd_;
+  TiledMapHeader header_;
+  std::vector<TiledMapTileEntry> directory_;
+
+  // the tiles whose bounding box overlaps each cell of a grid of tile_length
+  // cells, only the cells holding a tile are stored. getFrenet only looks at
+  // the tiles in the cells around the point instead of the whole directory.
+  std::unordered_map<uint64_t, std::vector<int> > grid_;
+
+  // LRU cache, most recently used tile in front
+  int max_resident_;
+  std::mutex cache_mutex_;
+  std::list<std::pair<int, TilePtr> > lru_;
+  std::unordered_map<int, std::list<std::pair<int, TilePtr> >::iterator> cache_;
+  Stats stats_;
+
+  // prefetch requests for the background thread
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  std::deque<int> queue_;
+  bool stop_;
+  std::thread prefetch_thread_;
+
+  // tile of the last getFrenet, searched first
+  int last_tile_;
+};
+
+#endif // TILED_MAP_H
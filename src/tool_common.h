@@ -0,0 +1,44 @@
+#ifndef TOOL_COMMON_H
+#define TOOL_COMMON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// what path_planning and the tools around it share: the map files they load,
+// the checksum over the replies and the latency percentiles they report.
+// the paths are relative to the build directory the programs run from.
+
+// tiled map written by map_convert --tiles, for routes too long to load whole
+static const char kMapTilesFile[] = "../data/highway_map.tiles";
+// binary map written by map_convert, with the csv map as fallback
+static const char kMapBinFile[] = "../data/highway_map.bin";
+// waypoint map to read from
+static const char kMapCsvFile[] = "../data/highway_map.csv";
+// the max s value before wrapping around the track back to 0
+static const double kMapMaxS = 6945.554;
+
+// 64 bit FNV-1a, a checksum starts at the basis and hashes every reply into it
+static const uint64_t kFnv1aBasis = 14695981039346656037ULL;
+
+inline uint64_t Fnv1a(uint64_t hash, const char *data, size_t length)
+{
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// the p-th percentile of sorted values, nearest rank, 0 if there are none
+inline double Percentile(const std::vector<double> &sorted, double p)
+{
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t i = (size_t)(p / 100 * (sorted.size() - 1) + 0.5);
+  return sorted[i];
+}
+
+#endif // TOOL_COMMON_H
@@ -0,0 +1,134 @@
+#include "waypoint_kdtree.h"
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+WaypointKdTree::WaypointKdTree()
+  : index_(NULL), x_(NULL), y_(NULL), n_(0)
+{
+}
+
+WaypointKdTree::WaypointKdTree(const vector<double> &maps_x, const vector<double> &maps_y)
+  : index_(NULL), x_(NULL), y_(NULL), n_(0)
+{
+  Build(maps_x, maps_y);
+}
+
+void WaypointKdTree::Build(const vector<double> &maps_x, const vector<double> &maps_y)
+{
+  Build(maps_x.data(), maps_y.data(), (int)maps_x.size());
+}
+
+void WaypointKdTree::Build(const double *maps_x, const double *maps_y, int n)
+{
+  own_index_.resize(n);
+  own_x_.assign(maps_x, maps_x + n);
+  own_y_.assign(maps_y, maps_y + n);
+
+  for(int i = 0; i < n; i++)
+  {
+    own_index_[i] = i;
+  }
+
+  BuildRange(0, n, 0);
+
+  // gather coordinates into tree order
+  for(int i = 0; i < n; i++)
+  {
+    own_x_[i] = maps_x[own_index_[i]];
+    own_y_[i] = maps_y[own_index_[i]];
+  }
+
+  index_ = own_index_.data();
+  x_ = own_x_.data();
+  y_ = own_y_.data();
+  n_ = n;
+}
+
+void WaypointKdTree::Borrow(const int32_t *index, const double *x, const double *y, int n)
+{
+  own_index_.clear();
+  own_x_.clear();
+  own_y_.clear();
+
+  index_ = index;
+  x_ = x;
+  y_ = y;
+  n_ = n;
+}
+
+// split range [lo,hi) at its median, x on even depths and y on odd depths
+void WaypointKdTree::BuildRange(int lo, int hi, int depth)
+{
+  if(hi - lo <= 1)
+  {
+    return;
+  }
+
+  int mid = lo + (hi - lo) / 2;
+
+  // coordinates are still in waypoint order while building
+  const vector<double> &key = (depth % 2 == 0) ? own_x_ : own_y_;
+
+  nth_element(own_index_.begin() + lo, own_index_.begin() + mid, own_index_.begin() + hi,
+              [&key](int a, int b) { return key[a] < key[b]; });
+
+  BuildRange(lo, mid, depth + 1);
+  BuildRange(mid + 1, hi, depth + 1);
+}
+
+int WaypointKdTree::Closest(double x, double y) const
+{
+  int best = -1;
+  double best_dist2 = numeric_limits<double>::infinity();
+
+  Search(0, n_, 0, x, y, best, best_dist2);
+
+  return best;
+}
+
+void WaypointKdTree::Search(int lo, int hi, int depth, double x, double y, int &best, double &best_dist2) const
+{
+  if(lo >= hi)
+  {
+    return;
+  }
+
+  int mid = lo + (hi - lo) / 2;
+
+  // compare squared distances, no sqrt needed for ranking
+  double dx = x_[mid] - x;
+  double dy = y_[mid] - y;
+  double dist2 = dx*dx + dy*dy;
+
+  if(dist2 < best_dist2 || (dist2 == best_dist2 && index_[mid] < best))
+  {
+    best_dist2 = dist2;
+    best = index_[mid];
+  }
+
+  // signed distance to the splitting plane
+  double diff = (depth % 2 == 0) ? (x - x_[mid]) : (y - y_[mid]);
+
+  // descend into the side of the query point first
+  if(diff < 0)
+  {
+    Search(lo, mid, depth + 1, x, y, best, best_dist2);
+    if(diff*diff <= best_dist2)
+    {
+      Search(mid + 1, hi, depth + 1, x, y, best, best_dist2);
+    }
+  }
+  else
+  {
+    Search(mid + 1, hi, depth + 1, x, y, best, best_dist2);
+    if(diff*diff <= best_dist2)
+    {
+      Search(lo, mid, depth + 1, x, y, best, best_dist2);
+    }
+  }
+}
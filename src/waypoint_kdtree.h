@@ -0,0 +1,54 @@
+#ifndef WAYPOINT_KDTREE_H
+#define WAYPOINT_KDTREE_H
+
+#include <stdint.h>
+#include <vector>
+
+// static 2-d tree over the map waypoints for nearest waypoint queries.
+// the tree is built once at load time and stored implicitly: node ranges are
+// halved at their median, so no child pointers are needed and the reordered
+// coordinates lie next to each other in memory.
+class WaypointKdTree
+{
+public:
+  WaypointKdTree();
+  WaypointKdTree(const std::vector<double> &maps_x, const std::vector<double> &maps_y);
+
+  void Build(const std::vector<double> &maps_x, const std::vector<double> &maps_y);
+  void Build(const double *maps_x, const double *maps_y, int n);
+
+  // use a tree that was built earlier in place, e.g. one stored in a map file.
+  // the arrays must outlive the tree.
+  void Borrow(const int32_t *index, const double *x, const double *y, int n);
+
+  // index of the waypoint closest to (x,y), -1 if the tree is empty.
+  // on equal distances the lower waypoint index wins, like the linear scan.
+  int Closest(double x, double y) const;
+
+  int size() const { return n_; }
+
+  // waypoint index, x and y of the nodes in tree order
+  const int32_t *index() const { return index_; }
+  const double *x() const { return x_; }
+  const double *y() const { return y_; }
+
+private:
+  WaypointKdTree(const WaypointKdTree &);
+  WaypointKdTree &operator=(const WaypointKdTree &);
+
+  void BuildRange(int lo, int hi, int depth);
+  void Search(int lo, int hi, int depth, double x, double y, int &best, double &best_dist2) const;
+
+  // waypoint index, x and y of every tree node in tree order
+  const int32_t *index_;
+  const double *x_;
+  const double *y_;
+  int n_;
+
+  // storage of a tree built by this object
+  std::vector<int32_t> own_index_;
+  std::vector<double> own_x_;
+  std::vector<double> own_y_;
+};
+
+#endif // WAYPOINT_KDTREE_H
@@ -0,0 +1,101 @@
+#include "worker_pool.h"
+
+using namespace std;
+
+WorkerPool::WorkerPool(int threads)
+  : next_queue_(0), queued_(0), stop_(false), tasks_(0), steals_(0)
+{
+  if(threads < 1)
+  {
+    threads = 1;
+  }
+  for(int i = 0; i < threads; i++)
+  {
+    queues_.push_back(unique_ptr<Queue>(new Queue()));
+  }
+  for(int i = 0; i < threads; i++)
+  {
+    threads_.push_back(thread(&WorkerPool::WorkerLoop, this, i));
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    lock_guard<mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for(size_t i = 0; i < threads_.size(); i++)
+  {
+    threads_[i].join();
+  }
+}
+
+void WorkerPool::Submit(Task *task)
+{
+  Queue &queue = *queues_[next_queue_++ % queues_.size()];
+  {
+    lock_guard<mutex> lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+  queued_++;
+
+  // taking the lock orders this against a worker that checked queued_ and is about to sleep
+  {
+    lock_guard<mutex> lock(sleep_mutex_);
+  }
+  wake_.notify_one();
+}
+
+WorkerPool::Task *WorkerPool::Take(int index)
+{
+  int n = queues_.size();
+  for(int k = 0; k < n; k++)
+  {
+    Queue &queue = *queues_[(index + k) % n];
+    lock_guard<mutex> lock(queue.mutex);
+    if(queue.tasks.empty())
+    {
+      continue;
+    }
+
+    // the own queue is worked from the front, the others are robbed from the back
+    Task *task;
+    if(k == 0)
+    {
+      task = queue.tasks.front();
+      queue.tasks.pop_front();
+    }
+    else
+    {
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+      steals_++;
+    }
+    queued_--;
+    return task;
+  }
+  return NULL;
+}
+
+void WorkerPool::WorkerLoop(int index)
+{
+  for(;;)
+  {
+    Task *task = Take(index);
+    if(task != NULL)
+    {
+      tasks_++;
+      task->Run();
+      continue;
+    }
+
+    unique_lock<mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+    if(stop_ && queued_ == 0)
+    {
+      return;
+    }
+  }
+}
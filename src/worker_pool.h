@@ -0,0 +1,69 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed pool of threads running tasks handed over from other threads. every
+// worker has a queue of its own, Submit() deals tasks out round robin and a
+// worker whose queue runs dry steals from the back of the others, so a few
+// slow tasks don't hold up the ones queued behind them. tasks run in no
+// particular order, callers that need an order submit the next task when the
+// last one is done.
+class WorkerPool
+{
+public:
+  // a unit of work, owned by the caller, which must keep it alive until Run() returns
+  class Task
+  {
+  public:
+    virtual ~Task() {}
+    virtual void Run() = 0;
+  };
+
+  explicit WorkerPool(int threads);
+  // runs the tasks still queued, then joins the threads
+  ~WorkerPool();
+
+  // queue a task, from any thread
+  void Submit(Task *task);
+
+  int threads() const { return threads_.size(); }
+  // tasks run and those of them taken from another worker's queue
+  long tasks() const { return tasks_; }
+  long steals() const { return steals_; }
+
+private:
+  WorkerPool(const WorkerPool &);
+  WorkerPool &operator=(const WorkerPool &);
+
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Task *> tasks;
+  };
+
+  void WorkerLoop(int index);
+  // the next task of worker index, its own first, NULL if all queues are empty
+  Task *Take(int index);
+
+  std::vector<std::unique_ptr<Queue> > queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<unsigned> next_queue_;
+
+  // tasks queued and not taken yet, idle workers sleep while there are none
+  std::atomic<long> queued_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+
+  std::atomic<long> tasks_;
+  std::atomic<long> steals_;
+};
+
+#endif // WORKER_POOL_H